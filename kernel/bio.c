@@ -33,12 +33,16 @@ struct {
   struct buf head;
 } bcache;
 
+static int kshit, ksmiss;  // kstat counters
+
 void
 binit(void)
 {
   struct buf *b;
 
   initlock(&bcache.lock, "bcache");
+  kshit = kstat_register("bcache_hit");
+  ksmiss = kstat_register("bcache_miss");
 
   // Create linked list of buffers
   bcache.head.prev = &bcache.head;
@@ -67,6 +71,7 @@ bget(uint dev, uint blockno)
     if(b->dev == dev && b->blockno == blockno){
       b->refcnt++;
       release(&bcache.lock);
+      kstat_add(kshit, 1);
       acquiresleep(&b->lock);
       return b;
     }
@@ -81,6 +86,7 @@ bget(uint dev, uint blockno)
       b->valid = 0;
       b->refcnt = 1;
       release(&bcache.lock);
+      kstat_add(ksmiss, 1);
       acquiresleep(&b->lock);
       return b;
     }
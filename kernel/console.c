@@ -20,6 +20,7 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "defs.h"
+#include "timer.h"
 #include "proc.h"
 
 #define BACKSPACE 0x100
@@ -89,7 +90,7 @@ consoleread(int user_dst, uint64 dst, int n)
     // wait until interrupt handler has put some
     // input into cons.buffer.
     while(cons.r == cons.w){
-      if(killed(myproc())){
+      if(interrupted(myproc())){
         release(&cons.lock);
         return -1;
       }
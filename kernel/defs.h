@@ -2,12 +2,17 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct lockstat;
 struct pipe;
 struct proc;
+struct rwspinlock;
+struct seqlock;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct tgroup;
+struct timer;
 
 // bio.c
 void            binit(void);
@@ -42,6 +47,7 @@ struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit();
 void            ilock(struct inode*);
+void            ilockshared(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
 void            iunlockput(struct inode*);
@@ -85,16 +91,20 @@ void            printfinit(void);
 void            backtrace(void);
 
 // proc.c
+extern struct spinlock wait_lock;
+extern volatile int onlinecpus;
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
-int             growproc(int);
-void            proc_mapstacks(pagetable_t);
+int             growproc(int, uint64*);
 pagetable_t     proc_pagetable(struct proc *);
-void            proc_freepagetable(pagetable_t, uint64);
+void            proc_freepagetable(pagetable_t, uint64, int);
 int             kill(int);
 int             killed(struct proc*);
 void            setkilled(struct proc*);
+int             interrupted(struct proc*);
+int             sigsend(int, int);
+void            sigpost(struct proc*, int);
 struct cpu*     mycpu(void);
 struct cpu*     getmycpu(void);
 struct proc*    myproc();
@@ -104,12 +114,28 @@ void            sched(void);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(uint64);
+int             clone(uint64, uint64, uint64);
+int             join(int, uint64);
+int             kthread(void (*)(void), char*);
 void            wakeup(void*);
+void            wakeupsync(void*);
+void            handoffcancel(void);
+int             wakeupn(void*, int);
+void            wakeproc(struct proc*, void*);
+void            usyscallupdate(struct proc*);
 void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
-void            trace(int);
+int             setweight(int, int);
+int             setaffinity(int, int);
+int             getaffinity(int);
+int             schedstat(int, uint64, int);
+int             setrt(int, uint64, uint64, uint64);
+int             rtyield(void);
+int             rtthrottle(void);
+void            loadupdate(uint);
+void            getloadavg(int*);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -122,10 +148,26 @@ void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
 
+// rwlock.c
+void            initrwlock(struct rwspinlock*, char*);
+void            acquireread(struct rwspinlock*);
+void            releaseread(struct rwspinlock*);
+void            acquirewrite(struct rwspinlock*);
+void            releasewrite(struct rwspinlock*);
+int             holdingwrite(struct rwspinlock*);
+void            initseqlock(struct seqlock*, char*);
+void            writeseqlock(struct seqlock*);
+void            writesequnlock(struct seqlock*);
+uint            readseqbegin(struct seqlock*);
+int             readseqretry(struct seqlock*, uint);
+
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
+void            acquiresleepshared(struct sleeplock*);
+void            releasesleepshared(struct sleeplock*);
+int             holdingsleepshared(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
 // string.c
@@ -144,13 +186,73 @@ void            argaddr(int, uint64 *);
 int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
+uint64          syscallrun(int, uint64*);
 
 // trap.c
 extern uint     ticks;
+extern uint64   tickbase;
 void            trapinit(void);
 void            trapinithart(void);
-extern struct spinlock tickslock;
+extern struct seqlock tickslock;
 void            usertrapret(void);
+void            clockarm(void);
+uint            tickupdate(void);
+uint            uptime(void);
+
+// futex.c
+void            futexinit(void);
+int             futex_wait(uint64, int);
+int             futex_wake(uint64, int);
+
+// timer.c
+void            timerqinit(void);
+int             timer_add(struct timer*);
+void            timer_cancel(struct timer*);
+uint64          timer_next(void);
+int             timerintr(void);
+int             sleepuntil(uint64);
+
+// prof.c
+extern uint64   profinterval;
+void            profinit(void);
+void            profsample(uint64, uint64);
+
+// signal.c
+void            sigdeliver(void);
+void            sigexec(struct proc*);
+
+// uprof.c
+void            uprofree(struct proc*);
+void            uprofarm(struct proc*);
+void            uprofsample(struct proc*, uint64);
+
+// ipi.c
+void            ipisend(int);
+int             ipiintr(void);
+void            ipicall(int, void (*)(void*), void*);
+void            tlbshootdown(struct tgroup*);
+
+// lockstat.c
+#ifdef LOCKSTAT
+int             lockstat_register(char*, int);
+void            lockstat_acquire(int, uint64);
+void            lockstat_release(int, uint64);
+#else
+// without LOCKSTAT, locks count nothing, and look up no time.
+#define lockstat_acquire(id, spins) ((void)(spins))
+#define lockstat_release(id, held)  ((void)0)
+#endif
+
+// kstat.c
+int             kstat_register(char*);
+void            kstat_add(int, uint64);
+
+// trace.c
+void            traceinit(void);
+void            tracerecord(int, int, uint64*, uint64, uint64);
+
+// uring.c
+void            uringfree(struct tgroup*);
 
 // uart.c
 void            uartinit(void);
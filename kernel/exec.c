@@ -3,6 +3,7 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "timer.h"
 #include "proc.h"
 #include "defs.h"
 #include "elf.h"
@@ -31,13 +32,19 @@ exec(char *path, char **argv)
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
 
+  // the other threads would be left running in a
+  // vanished address space, as would a uring's thread,
+  // and its rings would vanish from under the process.
+  if(p->tg->ref > 1 || p->tg->uring)
+    return -1;
+
   begin_op();
 
   if((ip = namei(path)) == 0){
     end_op();
     return -1;
   }
-  ilock(ip);
+  ilockshared(ip);
 
   // Check ELF header
   if(readi(ip, 0, (uint64)&elf, 0, sizeof(elf)) != sizeof(elf))
@@ -73,7 +80,7 @@ exec(char *path, char **argv)
   ip = 0;
 
   p = myproc();
-  uint64 oldsz = p->sz;
+  uint64 oldsz = p->tg->sz;
 
   // Allocate some pages at the next page boundary.
   // Make the first inaccessible as a stack guard.
@@ -121,18 +128,19 @@ exec(char *path, char **argv)
   safestrcpy(p->name, last, sizeof(p->name));
     
   // Commit to the user image.
+  sigexec(p);
   oldpagetable = p->pagetable;
-  p->pagetable = pagetable;
-  p->sz = sz;
+  p->pagetable = p->tg->pagetable = pagetable;
+  p->tg->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
-  proc_freepagetable(oldpagetable, oldsz);
+  proc_freepagetable(oldpagetable, oldsz, p->tfslot);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
 
  bad:
   if(pagetable)
-    proc_freepagetable(pagetable, sz);
+    proc_freepagetable(pagetable, sz, p->tfslot);
   if(ip){
     iunlockput(ip);
     end_op();
@@ -11,6 +11,7 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "stat.h"
+#include "timer.h"
 #include "proc.h"
 
 struct devsw devsw[NDEV];
@@ -91,7 +92,7 @@ filestat(struct file *f, uint64 addr)
   struct stat st;
   
   if(f->type == FD_INODE || f->type == FD_DEVICE){
-    ilock(f->ip);
+    ilockshared(f->ip);
     stati(f->ip, &st);
     iunlock(f->ip);
     if(copyout(p->pagetable, addr, (char *)&st, sizeof(st)) < 0)
@@ -101,6 +102,18 @@ filestat(struct file *f, uint64 addr)
   return -1;
 }
 
+// Whether nobody else can read through f at the same time:
+// f is in no other process's file table, and this process has
+// no other threads. If so, reads can share the inode lock, as
+// it needn't keep f->off in order too. Both counts may rise
+// meanwhile, but a read that sees them raised locks the inode
+// alone, and so waits for reads that didn't.
+static int
+offprivate(struct file *f)
+{
+  return f->ref == 1 && myproc()->tg->ref == 1;
+}
+
 // Read from file f.
 // addr is a user virtual address.
 int
@@ -118,7 +131,10 @@ fileread(struct file *f, uint64 addr, int n)
       return -1;
     r = devsw[f->major].read(1, addr, n);
   } else if(f->type == FD_INODE){
-    ilock(f->ip);
+    if(offprivate(f))
+      ilockshared(f->ip);
+    else
+      ilock(f->ip);
     if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
       f->off += r;
     iunlock(f->ip);
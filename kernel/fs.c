@@ -15,6 +15,8 @@
 #include "param.h"
 #include "stat.h"
 #include "spinlock.h"
+#include "rwlock.h"
+#include "timer.h"
 #include "proc.h"
 #include "sleeplock.h"
 #include "fs.h"
@@ -164,17 +166,24 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The itable.lock spin-lock protects the allocation of itable
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
+// The itable.lock reader-writer spin-lock protects the allocation
+// of itable entries. Since ip->ref indicates whether an entry is
+// free, and ip->dev and ip->inum indicate which i-node an entry
 // holds, one must hold itable.lock while using any of those fields.
+// Holding it for reading is enough to look for an entry, and to
+// change the ref of one that is in use, atomically and never to
+// or from zero; only a writer may take an entry or let one go.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
+// Code that only reads the inode and its content, such as
+// readi(), dirlookup() and stati(), may hold ip->lock shared,
+// from ilockshared(), so that readers of a file or directory
+// run side by side; anything that writes must hold it alone.
 
 struct {
-  struct spinlock lock;
+  struct rwspinlock lock;
   struct inode inode[NINODE];
 } itable;
 
@@ -183,7 +192,7 @@ iinit()
 {
   int i = 0;
   
-  initlock(&itable.lock, "itable");
+  initrwlock(&itable.lock, "itable");
   for(i = 0; i < NINODE; i++) {
     initsleeplock(&itable.inode[i].lock, "inode");
   }
@@ -248,14 +257,25 @@ iget(uint dev, uint inum)
 {
   struct inode *ip, *empty;
 
-  acquire(&itable.lock);
-
   // Is the inode already in the table?
+  acquireread(&itable.lock);
+  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
+    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
+      __atomic_fetch_add(&ip->ref, 1, __ATOMIC_RELAXED);
+      releaseread(&itable.lock);
+      return ip;
+    }
+  }
+  releaseread(&itable.lock);
+
+  // Look again, since another process may have brought it
+  // in between the locks.
+  acquirewrite(&itable.lock);
   empty = 0;
   for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
     if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
       ip->ref++;
-      release(&itable.lock);
+      releasewrite(&itable.lock);
       return ip;
     }
     if(empty == 0 && ip->ref == 0)    // Remember empty slot.
@@ -271,7 +291,7 @@ iget(uint dev, uint inum)
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
-  release(&itable.lock);
+  releasewrite(&itable.lock);
 
   return ip;
 }
@@ -281,9 +301,9 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&itable.lock);
-  ip->ref++;
-  release(&itable.lock);
+  acquireread(&itable.lock);
+  __atomic_fetch_add(&ip->ref, 1, __ATOMIC_RELAXED);
+  releaseread(&itable.lock);
   return ip;
 }
 
@@ -316,14 +336,39 @@ ilock(struct inode *ip)
   }
 }
 
-// Unlock the given inode.
+// Lock the given inode shared, for reading only.
+// Reads the inode from disk if necessary.
+void
+ilockshared(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("ilockshared");
+
+  acquiresleepshared(&ip->lock);
+
+  if(ip->valid == 0){
+    // reading it in writes ip, which needs the lock alone;
+    // it stays valid while we hold a reference.
+    releasesleepshared(&ip->lock);
+    ilock(ip);
+    iunlock(ip);
+    acquiresleepshared(&ip->lock);
+  }
+}
+
+// Unlock the given inode, locked alone or shared.
 void
 iunlock(struct inode *ip)
 {
-  if(ip == 0 || !holdingsleep(&ip->lock) || ip->ref < 1)
+  if(ip == 0 || ip->ref < 1)
     panic("iunlock");
 
-  releasesleep(&ip->lock);
+  if(holdingsleep(&ip->lock))
+    releasesleep(&ip->lock);
+  else if(holdingsleepshared(&ip->lock))
+    releasesleepshared(&ip->lock);
+  else
+    panic("iunlock");
 }
 
 // Drop a reference to an in-memory inode.
@@ -336,7 +381,20 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
-  acquire(&itable.lock);
+  int ref;
+
+  // Not the last reference: just drop it.
+  acquireread(&itable.lock);
+  ref = __atomic_load_n(&ip->ref, __ATOMIC_RELAXED);
+  while(ref > 1)
+    if(__atomic_compare_exchange_n(&ip->ref, &ref, ref - 1, 1,
+                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+      releaseread(&itable.lock);
+      return;
+    }
+  releaseread(&itable.lock);
+
+  acquirewrite(&itable.lock);
 
   if(ip->ref == 1 && ip->valid && ip->nlink == 0){
     // inode has no links and no other references: truncate and free.
@@ -345,7 +403,7 @@ iput(struct inode *ip)
     // so this acquiresleep() won't block (or deadlock).
     acquiresleep(&ip->lock);
 
-    release(&itable.lock);
+    releasewrite(&itable.lock);
 
     itrunc(ip);
     ip->type = 0;
@@ -354,11 +412,11 @@ iput(struct inode *ip)
 
     releasesleep(&ip->lock);
 
-    acquire(&itable.lock);
+    acquirewrite(&itable.lock);
   }
 
   ip->ref--;
-  release(&itable.lock);
+  releasewrite(&itable.lock);
 }
 
 // Common idiom: unlock, then put.
@@ -453,7 +511,7 @@ itrunc(struct inode *ip)
 }
 
 // Copy stat information from inode.
-// Caller must hold ip->lock.
+// Caller must hold ip->lock, perhaps shared.
 void
 stati(struct inode *ip, struct stat *st)
 {
@@ -465,7 +523,8 @@ stati(struct inode *ip, struct stat *st)
 }
 
 // Read data from inode.
-// Caller must hold ip->lock.
+// Caller must hold ip->lock, perhaps shared: every block
+// below ip->size exists, so bmap() won't allocate one.
 // If user_dst==1, then dst is a user virtual address;
 // otherwise, dst is a kernel address.
 int
@@ -548,6 +607,7 @@ namecmp(const char *s, const char *t)
 
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
+// Caller must hold dp->lock, perhaps shared.
 struct inode*
 dirlookup(struct inode *dp, char *name, uint *poff)
 {
@@ -655,11 +715,15 @@ namex(char *path, int nameiparent, char *name)
 
   if(*path == '/')
     ip = iget(ROOTDEV, ROOTINO);
-  else
-    ip = idup(myproc()->cwd);
+  else {
+    struct tgroup *tg = myproc()->tg;
+    acquire(&tg->lock);  // chdir() in another thread may replace cwd
+    ip = idup(tg->cwd);
+    release(&tg->lock);
+  }
 
   while((path = skipelem(path, name)) != 0){
-    ilock(ip);
+    ilockshared(ip);
     if(ip->type != T_DIR){
       iunlockput(ip);
       return 0;
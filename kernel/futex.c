@@ -0,0 +1,111 @@
+// Futexes: sleep until an int in user memory changes.
+//
+// A futex is keyed by the physical address of the int, so
+// threads sharing an address space and processes sharing a
+// page (until copy-on-write splits it) meet on the same key.
+// A waiter sleeps with the key as its sleep() channel, under
+// the lock of the key's hash bucket, which futex_wake() also
+// takes; a wake-up that comes after the waiter checked the
+// int cannot be lost.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NFUTEXQ 31
+
+static struct spinlock futexq[NFUTEXQ];
+
+void
+futexinit(void)
+{
+  for(int i = 0; i < NFUTEXQ; i++)
+    initlock(&futexq[i], "futex");
+}
+
+// The physical address of the int at user address va,
+// or 0 if va is not a mapped, aligned user address.
+static uint64
+futexkey(uint64 va)
+{
+  uint64 pa;
+
+  if(va % sizeof(int) != 0)
+    return 0;
+  if((pa = walkaddr(myproc()->pagetable, PGROUNDDOWN(va))) == 0)
+    return 0;
+  return pa + va % PGSIZE;
+}
+
+static struct spinlock*
+futexlock(uint64 key)
+{
+  return &futexq[(key / sizeof(int)) % NFUTEXQ];
+}
+
+// Sleep if the int at va still holds val, until a futex_wake()
+// on it. Returns -1 at once if it does not, and if va is bad
+// or the process is killed.
+int
+futex_wait(uint64 va, int val)
+{
+  uint64 key;
+  struct spinlock *lk;
+
+  if((key = futexkey(va)) == 0)
+    return -1;
+  lk = futexlock(key);
+  acquire(lk);
+  if(__atomic_load_n((int*)key, __ATOMIC_SEQ_CST) != val || interrupted(myproc())){
+    release(lk);
+    return -1;
+  }
+  sleep((void*)key, lk);
+  release(lk);
+  return 0;
+}
+
+// Wake up to n futex_wait()ers on the int at va.
+// Returns the number woken, or -1 if va is bad.
+int
+futex_wake(uint64 va, int n)
+{
+  uint64 key;
+  struct spinlock *lk;
+  int woken;
+
+  if((key = futexkey(va)) == 0)
+    return -1;
+  lk = futexlock(key);
+  acquire(lk);
+  woken = wakeupn((void*)key, n);
+  release(lk);
+  return woken;
+}
+
+uint64
+sys_futex_wait(void)
+{
+  uint64 va;
+  int val;
+
+  argaddr(0, &va);
+  argint(1, &val);
+  return futex_wait(va, val);
+}
+
+uint64
+sys_futex_wake(void)
+{
+  uint64 va;
+  int n;
+
+  argaddr(0, &va);
+  argint(1, &n);
+  return futex_wake(va, n);
+}
@@ -0,0 +1,120 @@
+// Inter-processor interrupts.
+//
+// A hart interrupts another by writing the other's msip register
+// in the CLINT, which raises a machine-mode software interrupt.
+// Machine-mode interrupts can't be delegated, so machinevec in
+// kernelvec.S clears msip and raises a supervisor software
+// interrupt in its place, which devintr() hands to ipiintr().
+//
+// The interrupt alone ends a wfi, which is all that kick() in
+// proc.c needs to have an idle hart look at its queues again.
+// ipicall() also runs a function on other harts, one call at a
+// time system-wide; tlbshootdown() is built on it.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "proc.h"
+#include "defs.h"
+
+static struct {
+  int busy;               // a call is in progress
+  void (*fn)(void*);
+  void *arg;
+  int pending;            // harts yet to run fn, a bit each
+} call;
+
+// Interrupt hart cpu.
+void
+ipisend(int cpu)
+{
+  *(volatile uint32*)CLINT_MSIP(cpu) = 1;
+}
+
+// Run the call in progress if this hart is yet to.
+// Interrupts must be disabled.
+static void
+ipipoll(void)
+{
+  int bit = 1 << cpuid();
+
+  if(__atomic_load_n(&call.pending, __ATOMIC_ACQUIRE) & bit){
+    call.fn(call.arg);
+    __atomic_fetch_and(&call.pending, ~bit, __ATOMIC_RELEASE);
+  }
+}
+
+// A supervisor software interrupt: take any call, and return 1
+// if the running process should give up the cpu to a real-time
+// process that another hart queued here.
+int
+ipiintr(void)
+{
+  struct cpu *c = mycpu();
+  struct proc *p = c->proc;
+
+  // clear the request before looking for work, so that
+  // a later request interrupts again.
+  w_sip(r_sip() & ~SIP_SSIP);
+  ipipoll();
+  return p != 0 && p->rt_period == 0 && c->rt.n > 0;
+}
+
+// Run fn(arg) on each hart in mask except this one, with
+// interrupts off there, and wait until all have returned.
+// Must be called without spinlocks held: a hart spinning for
+// one with interrupts off would never take the call.
+void
+ipicall(int mask, void (*fn)(void*), void *arg)
+{
+  push_off();
+  mask &= onlinecpus & ~(1 << cpuid());
+  if(mask == 0){
+    pop_off();
+    return;
+  }
+  // another hart's call may be waiting for this one, so
+  // take calls while waiting as well as while being served.
+  while(__atomic_exchange_n(&call.busy, 1, __ATOMIC_ACQUIRE))
+    ipipoll();
+  call.fn = fn;
+  call.arg = arg;
+  __atomic_store_n(&call.pending, mask, __ATOMIC_RELEASE);
+  for(int i = 0; i < NCPU; i++)
+    if(mask & (1 << i))
+      ipisend(i);
+  while(__atomic_load_n(&call.pending, __ATOMIC_ACQUIRE))
+    ;
+  __atomic_store_n(&call.busy, 0, __ATOMIC_RELEASE);
+  pop_off();
+}
+
+static void
+flush(void *arg)
+{
+  sfence_vma();
+}
+
+// Make sure that no hart uses a stale TLB entry for tg's user
+// memory, after its page table has lost mappings. Only harts
+// running a thread of tg can have such entries: every other hart
+// flushes its TLB when it next enters user space, in userret.
+// Must be called without spinlocks held; see ipicall().
+void
+tlbshootdown(struct tgroup *tg)
+{
+  struct proc *p;
+  int mask = 0;
+
+  // a thread that starts running after this look has switched
+  // to the page table as it is now.
+  for(int i = 0; i < NCPU; i++)
+    if((p = cpus[i].proc) != 0 && p->tg == tg)
+      mask |= 1 << i;
+  // the interrupt itself flushes a hart in user space, since
+  // uservec switches page tables; flush() covers the rest.
+  ipicall(mask, flush, 0);
+}
@@ -18,22 +18,27 @@ struct run {
   struct run *next;
 };
 
+// each cpu's list starts on a cache line of its own, so that
+// cpus allocating at once don't fight over one line.
 typedef struct {
   struct spinlock lock;
   struct run *freelist;
   int *ref_count;
   void * pa_start;
-} kmem_t;
+} __attribute__((aligned(CACHELINE))) kmem_t;
 
 kmem_t cpu_kmem[NCPU];
 
 void
 kinit()
 {
+  // lock names must outlive kinit(), for lockstat().
+  static char names[NCPU][8];
+
   for(int i=0;i<NCPU;i++){
-    char name[6] = "kmem_ ";
-    name[5] = '0' + i;
-    initlock(&cpu_kmem[i].lock, name);
+    safestrcpy(names[i], "kmem_ ", sizeof(names[i]));
+    names[i][5] = '0' + i;
+    initlock(&cpu_kmem[i].lock, names[i]);
   }
   freerange(end, (void*)PHYSTOP);
 }
@@ -72,6 +77,8 @@ freerange(void *pa_start, void *pa_end)
 // function to add 'n' to the ref count of physical address pa
 // panics if final ref count goes below 0
 // frees the page if ref count becomes zero
+// the ref counts are shared by all cpus, so they are changed
+// atomically; a cpu's lock only guards its free list.
 void
 krefcntadd(void *pa, int n) {
   struct run *r;
@@ -82,24 +89,25 @@ krefcntadd(void *pa, int n) {
   if(((uint64)pa % PGSIZE) != 0 || (char *)pa < pa_start || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
-  acquire(&cpu_kmem[cpu_id].lock);
   int *ref = &cpu_kmem[cpu_id].ref_count[((char *)pa - pa_start)/PGSIZE];
-  *ref += n;
+  int newref = __atomic_add_fetch(ref, n, __ATOMIC_ACQ_REL);
 
-  if (*ref < 0) {
+  if (newref < 0) {
     panic("krefcntadd");
   }
 
-  if (*ref == 0) {
+  if (newref == 0) {
     memset(pa, 1, PGSIZE);
     r = (struct run*)pa;
+    acquire(&cpu_kmem[cpu_id].lock);
     r->next = cpu_kmem[cpu_id].freelist;
     cpu_kmem[cpu_id].freelist = r;
+    release(&cpu_kmem[cpu_id].lock);
   }
-  release(&cpu_kmem[cpu_id].lock);
 }
 
 // returns the ref count of the page at pa
+// no lock: a page's count is a single word.
 int
 krefcnt(void *pa) {
   char * pa_start;
@@ -109,11 +117,8 @@ krefcnt(void *pa) {
   if(((uint64)pa % PGSIZE) != 0 || (char *)pa < pa_start || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
-  acquire(&cpu_kmem[cpu_id].lock);
-  int ref = cpu_kmem[cpu_id].ref_count[((char *)pa - pa_start)/PGSIZE];
-  release(&cpu_kmem[cpu_id].lock);
-
-  return ref;
+  return __atomic_load_n(&cpu_kmem[cpu_id].ref_count[((char *)pa - pa_start)/PGSIZE],
+                         __ATOMIC_ACQUIRE);
 }
 
 // Free the page of physical memory pointed at by pa,
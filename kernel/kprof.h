@@ -0,0 +1,11 @@
+// A kernel profiling sample, from kprofread().
+#define KPROFDEPTH 8
+
+struct kprofsample {
+  uint64 pc;                  // sepc at the timer interrupt
+  uint64 stack[KPROFDEPTH];   // callers' return addresses, innermost first
+  int depth;                  // entries used in stack
+  int pid;                    // running process, or 0 for the scheduler
+  int cpu;
+  int user;                   // pc is a user address; stack is empty
+};
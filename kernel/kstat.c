@@ -0,0 +1,79 @@
+// Per-cpu counters for hot kernel events.
+//
+// kstat_register() names a counter and gives it an id, and
+// kstat_add() adds to this cpu's slot of it, with interrupts off
+// but without a lock or an atomic instruction. Each cpu's slots
+// fill cache lines of their own, so counting never moves a line
+// between harts; kstat() sums the slots of all cpus.
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "proc.h"
+#include "kstat.h"
+#include "defs.h"
+
+static struct {
+  uint64 n[NKSTAT];
+} __attribute__((aligned(CACHELINE))) slots[NCPU];
+static char names[NKSTAT][16];
+static int nkstat;
+
+// A new counter named name. Returns its id, or -1 if there
+// are too many, which kstat_add() ignores.
+// Call only while booting, on hart 0.
+int
+kstat_register(char *name)
+{
+  if(nkstat == NKSTAT)
+    return -1;
+  safestrcpy(names[nkstat], name, sizeof(names[nkstat]));
+  return nkstat++;
+}
+
+// Count n events for counter id.
+void
+kstat_add(int id, uint64 n)
+{
+  if(id < 0)
+    return;
+  push_off();
+  slots[cpuid()].n[id] += n;
+  pop_off();
+}
+
+// Copy up to n counters to the user array at addr.
+// Returns the number copied.
+int
+kstat(uint64 addr, int n)
+{
+  struct proc *p = myproc();
+  struct kstat s;
+  int i, c;
+
+  if(n > nkstat)
+    n = nkstat;
+  for(i = 0; i < n; i++){
+    safestrcpy(s.name, names[i], sizeof(s.name));
+    s.value = 0;
+    // another cpu may be counting meanwhile; a slot is
+    // one word, so its count is read whole.
+    for(c = 0; c < NCPU; c++)
+      s.value += __atomic_load_n(&slots[c].n[i], __ATOMIC_RELAXED);
+    if(copyout(p->pagetable, addr + i*sizeof(s), (char*)&s, sizeof(s)) < 0)
+      return -1;
+  }
+  return n < 0 ? 0 : n;
+}
+
+uint64
+sys_kstat(void) {
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return kstat(addr, n);
+}
@@ -0,0 +1,7 @@
+// A kernel event counter, from kstat(): how many times the
+// event named name has happened since boot, on all cpus.
+#define NKSTAT 32
+struct kstat {
+  char name[16];
+  uint64 value;
+};
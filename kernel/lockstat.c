@@ -0,0 +1,159 @@
+// Lock contention statistics, in kernels built with
+// make LOCKSTAT=1; otherwise lockstat() fails, and locks
+// count nothing.
+//
+// initlock() and initsleeplock() give each lock the id of the
+// record for its name, made on first use, and acquire and
+// release add to this cpu's counts for that id, with interrupts
+// off but without an atomic instruction, the way kstat.c counts.
+// Each cpu's counts fill cache lines of their own, so locks of
+// one name held on several cpus don't share a line of counts;
+// lockstat() sums the cpus' counts.
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "proc.h"
+#include "lockstat.h"
+#include "defs.h"
+
+#ifdef LOCKSTAT
+
+#define NLOCKSTAT 64
+
+// A cpu's counts for one record.
+struct lockcount {
+  uint64 acquires;
+  uint64 contended;
+  uint64 spins;
+  uint64 holdtime;
+  uint64 maxhold;
+};
+
+static struct {
+  struct lockcount n[NLOCKSTAT];
+} __attribute__((aligned(CACHELINE))) slots[NCPU];
+static struct lockstat stats[NLOCKSTAT]; // names; counts are in slots
+static int nstats;
+static int statlock;     // not a spinlock, which would count itself
+
+// The id of the record for locks named name, made if need be.
+// Once the table is full, the last record collects all further
+// names.
+int
+lockstat_register(char *name, int sleep)
+{
+  int i;
+
+  push_off();
+  while(__sync_lock_test_and_set(&statlock, 1))
+    ;
+  for(i = 0; i < nstats; i++)
+    if(stats[i].sleep == sleep && strncmp(stats[i].name, name, sizeof(stats[i].name) - 1) == 0)
+      break;
+  if(i == nstats){
+    if(nstats < NLOCKSTAT)
+      nstats++;
+    else
+      i = NLOCKSTAT - 1;
+    if(stats[i].nlocks == 0){
+      safestrcpy(stats[i].name, i == NLOCKSTAT - 1 ? "other" : name, sizeof(stats[i].name));
+      stats[i].sleep = sleep;
+    }
+  }
+  stats[i].nlocks++;
+  __sync_lock_release(&statlock);
+  pop_off();
+  return i;
+}
+
+// A lock was acquired after spins turns of its wait loop.
+void
+lockstat_acquire(int id, uint64 spins)
+{
+  struct lockcount *n;
+
+  push_off();
+  n = &slots[cpuid()].n[id];
+  n->acquires++;
+  if(spins){
+    n->contended++;
+    n->spins += spins;
+  }
+  pop_off();
+}
+
+// A lock was released after being held for held cycles.
+void
+lockstat_release(int id, uint64 held)
+{
+  struct lockcount *n;
+
+  push_off();
+  n = &slots[cpuid()].n[id];
+  n->holdtime += held;
+  if(held > n->maxhold)
+    n->maxhold = held;
+  pop_off();
+}
+
+// Copy up to n records to the user array at addr, then zero
+// the counts if clear is set. Returns the number copied.
+int
+lockstat(uint64 addr, int n, int clear)
+{
+  struct proc *p = myproc();
+  struct lockstat s;
+  struct lockcount *k;
+  uint64 max;
+  int i, c;
+
+  if(n > nstats)
+    n = nstats;
+  for(i = 0; i < n; i++){
+    s = stats[i];
+    // other cpus may be counting meanwhile; each count is
+    // one word, so it is read whole.
+    for(c = 0; c < NCPU; c++){
+      k = &slots[c].n[i];
+      s.acquires += __atomic_load_n(&k->acquires, __ATOMIC_RELAXED);
+      s.contended += __atomic_load_n(&k->contended, __ATOMIC_RELAXED);
+      s.spins += __atomic_load_n(&k->spins, __ATOMIC_RELAXED);
+      s.holdtime += __atomic_load_n(&k->holdtime, __ATOMIC_RELAXED);
+      max = __atomic_load_n(&k->maxhold, __ATOMIC_RELAXED);
+      if(max > s.maxhold)
+        s.maxhold = max;
+    }
+    if(copyout(p->pagetable, addr + i*sizeof(s), (char*)&s, sizeof(s)) < 0)
+      return -1;
+  }
+  // a count another cpu is adding to as it is zeroed may
+  // keep its old value; close enough for statistics.
+  if(clear)
+    for(c = 0; c < NCPU; c++)
+      memset(slots[c].n, 0, nstats * sizeof(struct lockcount));
+  return n < 0 ? 0 : n;
+}
+
+#else
+
+int
+lockstat(uint64 addr, int n, int clear)
+{
+  return -1;
+}
+
+#endif
+
+uint64
+sys_lockstat(void) {
+  uint64 addr;
+  int n, clear;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  argint(2, &clear);
+  return lockstat(addr, n, clear);
+}
@@ -0,0 +1,15 @@
+// Contention statistics for the locks of one name, from
+// lockstat(). All the locks initialized with a name, such as
+// the "proc" lock of every process, share one record.
+// Times are in r_time() cycles, TIMEBASE to the second.
+struct lockstat {
+  char name[16];
+  int sleep;        // sleeplocks, rather than spinlocks
+  int nlocks;       // locks initialized with this name
+  uint64 acquires;
+  uint64 contended; // acquires that had to wait
+  uint64 spins;     // spin loops while waiting; sleeps, or spells
+                    // of spinning, for a sleeplock
+  uint64 holdtime;  // total time held
+  uint64 maxhold;   // longest time held
+};
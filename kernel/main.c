@@ -21,6 +21,10 @@ main()
     kvminithart();   // turn on paging
     procinit();      // process table
     trapinit();      // trap vectors
+    timerqinit();    // per-cpu timer queues
+    futexinit();     // futex hash buckets
+    profinit();      // kernel profiler
+    traceinit();     // syscall trace rings
     trapinithart();  // install kernel trap vector
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
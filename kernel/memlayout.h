@@ -25,6 +25,11 @@
 #define VIRTIO0 0x10001000
 #define VIRTIO0_IRQ 1
 
+// core local interruptor (CLINT), which holds each hart's
+// machine-mode software interrupt pending bit, msip.
+#define CLINT 0x2000000L
+#define CLINT_MSIP(hartid) (CLINT + 4*(hartid))
+
 // qemu puts platform-level interrupt controller (PLIC) here.
 #define PLIC 0x0c000000L
 #define PLIC_PRIORITY (PLIC + 0x0)
@@ -43,8 +48,9 @@
 // in both user and kernel space.
 #define TRAMPOLINE (MAXVA - PGSIZE)
 
-// map kernel stacks beneath the trampoline,
-// each surrounded by invalid guard pages.
+// kernel stacks go beneath the trampoline, each
+// surrounded by invalid guard pages; proc.c maps
+// one only while a proc is using it.
 #define KSTACK(p) (TRAMPOLINE - ((p)+1)* 2*PGSIZE)
 
 // User memory layout.
@@ -54,11 +60,40 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   URING (shared with user space, once set up)
+//   ...
+//   trapframes of other threads
+//   USYSCALL (shared with user space)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
 #define USYSCALL (TRAPFRAME - PGSIZE)
 
+// the trapframes of the threads a process clone()s sit beneath
+// USYSCALL, one page per trapframe slot; slot 0 is TRAPFRAME.
+#define TRAPFRAMEN(i) ((i) == 0 ? TRAPFRAME : USYSCALL - (uint64)(i)*PGSIZE)
+
+// the uring page, if the process has one, sits beneath room for
+// 31 trapframes; the heap stops short of it. see uring.h.
+#define URING (USYSCALL - 32*PGSIZE)
+
+// The USYSCALL page, which user code reads to answer some system
+// calls without a trap; see ulib.c. The kernel makes seq odd while
+// it changes the fields that can change, so a reader that saw seq
+// odd, or changed, must read again. User code reads the time CSR
+// itself, and uses the page to turn it into ticks and seconds.
+#define RLIMIT_NOFILE  0       // open files
+#define RLIMIT_STACK   1       // bytes of user stack
+#define RLIMIT_NTHREAD 2       // threads in a process
+#define NRLIMIT        3
 struct usyscall {
+  uint seq;
   int pid;
+  int ppid;                    // parent's pid, as of the last trap
+  int cpu;                     // cpu running the process, as of the last trap
+  uint64 starttime;            // r_time() when the process was created
+  uint64 tickbase;             // r_time() at boot
+  uint64 tickcycles;           // r_time() cycles per tick
+  uint64 timebase;             // r_time() cycles per second
+  uint64 rlimit[NRLIMIT];      // fixed limits, by RLIMIT_*
 };
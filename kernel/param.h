@@ -1,6 +1,9 @@
-#define NPROC        64  // maximum number of processes
+#define NPROC      4096  // maximum number of processes
+#define NTHREAD      16  // maximum threads per process
 #define NCPU          8  // maximum number of CPUs
+#define ALLCPUS       ((1 << NCPU) - 1) // affinity mask of every CPU
 #define NOFILE       16  // open files per process
+#define NSIG         32  // number of signals
 #define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
@@ -9,7 +12,17 @@
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       2000  // size of file system in blocks
+#define FSSIZE       3000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
 #define USERSTACK    1     // user stack pages
+#define DEFWEIGHT    1024  // default proportional-share weight
+#define MAXWEIGHT    (DEFWEIGHT*64) // largest weight setweight() accepts
+#define TIMEBASE     10000000 // r_time() cycles per second (qemu virt)
+#define TICKCYCLES   (TIMEBASE/10) // r_time() cycles per tick
+#define QUANTUM      TICKCYCLES // cycles a process runs before preemption
+#define NTIMER       NPROC // maximum pending timers per cpu
+#define RTMAXUTIL    95    // percent of a cpu that real-time procs may reserve
+#define NUPROF       16384 // buckets in a uprof() histogram
+#define SLEEPSPIN    (TIMEBASE/20000) // cycles to spin for a running sleeplock holder
+#define CACHELINE    64    // bytes in a cache line
 
@@ -3,6 +3,7 @@
 #include "defs.h"
 #include "param.h"
 #include "spinlock.h"
+#include "timer.h"
 #include "proc.h"
 #include "fs.h"
 #include "sleeplock.h"
@@ -81,12 +82,13 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
 
   acquire(&pi->lock);
   while(i < n){
-    if(pi->readopen == 0 || killed(pr)){
+    if(pi->readopen == 0 || interrupted(pr)){
       release(&pi->lock);
       return -1;
     }
     if(pi->nwrite == pi->nread + PIPESIZE){ //DOC: pipewrite-full
-      wakeup(&pi->nread);
+      // about to sleep: let the reader have this cpu.
+      wakeupsync(&pi->nread);
       sleep(&pi->nwrite, &pi->lock);
     } else {
       char ch;
@@ -111,7 +113,7 @@ piperead(struct pipe *pi, uint64 addr, int n)
 
   acquire(&pi->lock);
   while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
-    if(killed(pr)){
+    if(interrupted(pr)){
       release(&pi->lock);
       return -1;
     }
@@ -3,22 +3,77 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "rwlock.h"
+#include "timer.h"
 #include "proc.h"
+#include "schedstat.h"
+#include "signal.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
 
-struct proc proc[NPROC];
+// procs and tgroups are allocated on demand, a page of them
+// at a time, and never given back to kalloc(): a proc pointer
+// kept across a scan of allproc or a pid lookup always points
+// to a proc with a valid lock. A proc's kernel stack has an
+// address of its own, but is only mapped while the proc is used.
+struct proc *allproc;             // every proc, linked through allnext
+static struct proc *freeprocs;    // UNUSED procs, linked through freenext
+static struct tgroup *freetgroups; // linked through freenext
+static int nproc;                 // number of procs in allproc
+static uint kstackgen;            // bumped whenever a kstack is (un)mapped
+static int kscswitch;             // kstat counter
+
+// protects freeprocs, freetgroups, nproc, kstackgen
+// and kernel page table changes for kernel stacks.
+struct spinlock proc_lock;
+
+#define PROCPERPG (PGSIZE / sizeof(struct proc))
+#define TGPERPG   (PGSIZE / sizeof(struct tgroup))
 
 struct proc *initproc;
 
 int nextpid = 1;
-struct spinlock pid_lock;
+struct rwspinlock pid_lock;
+
+// procs by pid, chained through p->pidnext.
+// pid_lock must be held when using these, and
+// held for writing to change them.
+#define NPIDHASH 256
+static struct proc *pidhash[NPIDHASH];
+
+// mask of the harts that have entered scheduler().
+volatile int onlinecpus;
+
+// number of RUNNABLE and RUNNING procs, and its exponentially
+// decayed averages over 1, 5 and 15 minutes, in fixed point
+// with FSHIFT fraction bits, sampled every LOADFREQ ticks.
+// tickslock, a seqlock, protects loadavg and loadticks.
+#define FSHIFT   11
+#define FIXED_1  (1 << FSHIFT)
+#define LOADFREQ (5 * TIMEBASE / TICKCYCLES)  // five seconds
+static volatile int nactive;
+static uint64 loadavg[3];
+static uint loadticks;
+// FIXED_1/exp(5s/1min), FIXED_1/exp(5s/5min), FIXED_1/exp(5s/15min)
+static const uint64 loadexp[3] = { 1884, 2014, 2037 };
+
+// real-time procs are placed on a cpu by setrt(), which admits
+// one only if the cpu's reserved share stays within RTMAXUTIL.
+// shares are fractions of RTUNIT. rt_lock protects cpu rtutil.
+#define RTUNIT     (1UL << 20)
+#define RTMINSLICE (TIMEBASE / 1000)  // see rtrun()
+static struct spinlock rt_lock;
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static void setrunnable(struct proc *p);
+static void addchild(struct proc *parent, struct proc *p);
+static void tgfree(struct tgroup *tg);
+static int shrinkproc(struct tgroup *tg, uint64 newsz);
 
 extern char trampoline[]; // trampoline.S
+extern pagetable_t kernel_pagetable; // vm.c
 
 // helps ensure that wakeups of wait()ing
 // parents are not lost. helps obey the
@@ -26,35 +81,87 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
-// Allocate a page for each process's kernel stack.
-// Map it high in memory, followed by an invalid
-// guard page.
+// initialize the proc table.
 void
-proc_mapstacks(pagetable_t kpgtbl)
+procinit(void)
 {
-  struct proc *p;
-  
-  for(p = proc; p < &proc[NPROC]; p++) {
-    char *pa = kalloc();
-    if(pa == 0)
-      panic("kalloc");
-    uint64 va = KSTACK((int) (p - proc));
-    kvmmap(kpgtbl, va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
+  initlock(&proc_lock, "proc_lock");
+  initrwlock(&pid_lock, "nextpid");
+  kscswitch = kstat_register("cswitch");
+  initlock(&wait_lock, "wait_lock");
+  initlock(&rt_lock, "rt_lock");
+  for(int i = 0; i < NCPU; i++){
+    initlock(&cpus[i].rq.lock, "runq");
+    initlock(&cpus[i].rt.lock, "rtq");
   }
 }
 
-// initialize the proc table.
-void
-procinit(void)
+// Take an UNUSED proc off the free list, carving a new page
+// into procs if there are none, and map a kernel stack for it.
+// Returns 0 if there are NPROC procs already, or memory is short.
+static struct proc*
+procget(void)
 {
   struct proc *p;
-  
-  initlock(&pid_lock, "nextpid");
-  initlock(&wait_lock, "wait_lock");
-  for(p = proc; p < &proc[NPROC]; p++) {
+  char *mem;
+
+  acquire(&proc_lock);
+  if(freeprocs == 0 && nproc + PROCPERPG <= NPROC && (mem = kalloc()) != 0){
+    memset(mem, 0, PGSIZE);
+    for(p = (struct proc*)mem; p < (struct proc*)mem + PROCPERPG; p++){
       initlock(&p->lock, "proc");
       p->state = UNUSED;
-      p->kstack = KSTACK((int) (p - proc));
+      // followed by an invalid guard page.
+      p->kstack = KSTACK(nproc++);
+      p->freenext = freeprocs;
+      freeprocs = p;
+      // let scans see p only once it is set up.
+      __sync_synchronize();
+      p->allnext = allproc;
+      allproc = p;
+    }
+  }
+  if((p = freeprocs) != 0){
+    if((mem = kalloc()) == 0 ||
+       mappages(kernel_pagetable, p->kstack, PGSIZE, (uint64)mem, PTE_R | PTE_W) < 0){
+      if(mem)
+        kfree(mem);
+      p = 0;
+    } else {
+      freeprocs = p->freenext;
+      kstackgen++;
+    }
+  }
+  release(&proc_lock);
+  return p;
+}
+
+// Unmap p's kernel stack, and put p back on the free list.
+// p->lock must be held.
+static void
+procput(struct proc *p)
+{
+  acquire(&proc_lock);
+  uvmunmap(kernel_pagetable, p->kstack, 1, 1);
+  // other harts may still cache the old mapping; see kstacksync().
+  kstackgen++;
+  p->freenext = freeprocs;
+  freeprocs = p;
+  release(&proc_lock);
+}
+
+// Flush stale kernel stack mappings from this hart's TLB,
+// if any kernel stack has been mapped or unmapped since it
+// last did, before running a proc whose stack may be new.
+// Interrupts must be disabled.
+static void
+kstacksync(struct cpu *c)
+{
+  // unlocked read: a proc whose stack was mapped became
+  // RUNNABLE, under its lock, after kstackgen was bumped.
+  if(c->kstackgen != kstackgen){
+    c->kstackgen = kstackgen;
+    sfence_vma();
   }
 }
 
@@ -89,46 +196,241 @@ myproc(void)
   return p;
 }
 
-int
-allocpid()
+// Give p a new pid, and enter p in the pid hash table.
+static void
+allocpid(struct proc *p)
 {
-  int pid;
-  
-  acquire(&pid_lock);
-  pid = nextpid;
+  struct proc **hp;
+
+  acquirewrite(&pid_lock);
+  p->pid = nextpid;
   nextpid = nextpid + 1;
-  release(&pid_lock);
+  hp = &pidhash[p->pid % NPIDHASH];
+  p->pidnext = *hp;
+  *hp = p;
+  releasewrite(&pid_lock);
+}
 
-  return pid;
+// Remove p from the pid hash table.
+static void
+freepid(struct proc *p)
+{
+  struct proc **hp;
+
+  acquirewrite(&pid_lock);
+  for(hp = &pidhash[p->pid % NPIDHASH]; *hp != p; hp = &(*hp)->pidnext)
+    ;
+  *hp = p->pidnext;
+  p->pidnext = 0;
+  releasewrite(&pid_lock);
 }
 
-// Look in the process table for an UNUSED proc.
-// If found, initialize state required to run in the kernel,
-// and return with p->lock held.
-// If there are no free procs, or a memory allocation fails, return 0.
+// Return the process with the given pid, with
+// its lock held, or 0 if there is none.
 static struct proc*
-allocproc(void)
+findproc(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == UNUSED) {
-      goto found;
-    } else {
-      release(&p->lock);
+  if(pid <= 0)
+    return 0;
+  acquireread(&pid_lock);
+  for(p = pidhash[pid % NPIDHASH]; p != 0 && p->pid != pid; p = p->pidnext)
+    ;
+  releaseread(&pid_lock);
+  if(p == 0)
+    return 0;
+  acquire(&p->lock);
+  // p may have been freed, or even reused, since.
+  if(p->pid != pid){
+    release(&p->lock);
+    return 0;
+  }
+  return p;
+}
+
+// Allocate an unused thread group, with a usyscall page,
+// an empty address space and no files, holding one reference.
+static struct tgroup*
+tgalloc(void)
+{
+  struct tgroup *tg;
+  char *mem;
+
+  acquire(&proc_lock);
+  if(freetgroups == 0 && (mem = kalloc()) != 0){
+    memset(mem, 0, PGSIZE);
+    for(tg = (struct tgroup*)mem; tg < (struct tgroup*)mem + TGPERPG; tg++){
+      initlock(&tg->lock, "tgroup");
+      tg->freenext = freetgroups;
+      freetgroups = tg;
     }
   }
+  if((tg = freetgroups) != 0)
+    freetgroups = tg->freenext;
+  release(&proc_lock);
+  if(tg == 0)
+    return 0;
+
+  if((tg->usyscallpg = (struct usyscall *)kalloc()) == 0){
+    tgfree(tg);
+    return 0;
+  }
+  tg->ref = 1;
+  return tg;
+}
+
+// Fill in the usyscall page of p's new thread group.
+static void
+usyscallinit(struct proc *p)
+{
+  struct usyscall *u = p->tg->usyscallpg;
+
+  memset(u, 0, PGSIZE);
+  u->pid = p->pid;
+  u->cpu = -1;
+  u->starttime = r_time();
+  u->tickbase = tickbase;
+  u->tickcycles = TICKCYCLES;
+  u->timebase = TIMEBASE;
+  u->rlimit[RLIMIT_NOFILE] = NOFILE;
+  u->rlimit[RLIMIT_STACK] = USERSTACK*PGSIZE;
+  u->rlimit[RLIMIT_NTHREAD] = NTHREAD;
+}
+
+// Bring the usyscall page up to date on the way out to
+// user space. Only the thread in slot 0 does, so that the
+// page has one writer and needs no lock, just seq.
+void
+usyscallupdate(struct proc *p)
+{
+  struct usyscall *u = p->tg->usyscallpg;
+  struct proc *parent = p->parent;   // never freed, so safe to look at
+  int ppid = parent ? parent->pid : 0;
+  int cpu = cpuid();
+
+  if(p->tfslot != 0 || (u->ppid == ppid && u->cpu == cpu))
+    return;
+  __atomic_store_n(&u->seq, u->seq + 1, __ATOMIC_RELAXED);
+  __sync_synchronize();
+  u->ppid = ppid;
+  u->cpu = cpu;
+  __sync_synchronize();
+  __atomic_store_n(&u->seq, u->seq + 1, __ATOMIC_RELAXED);
+}
+
+// Put an unreferenced tg back on the free list.
+static void
+tgfree(struct tgroup *tg)
+{
+  acquire(&proc_lock);
+  tg->freenext = freetgroups;
+  freetgroups = tg;
+  release(&proc_lock);
+}
+
+// Add p to tg as a new thread: give p a trapframe slot
+// of its own, and map p's trapframe there.
+static int
+tgjoin(struct tgroup *tg, struct proc *p)
+{
+  int i;
+
+  acquire(&tg->lock);
+  // slot 0 belongs to the thread that created the group,
+  // even once it has exited; see exit().
+  for(i = 1; i < NTHREAD; i++)
+    if((tg->tfslots & (1 << i)) == 0)
+      break;
+  if(i == NTHREAD || mappages(tg->pagetable, TRAPFRAMEN(i), PGSIZE,
+                              (uint64)(p->trapframe), PTE_R | PTE_W) < 0){
+    release(&tg->lock);
+    return -1;
+  }
+  tg->tfslots |= 1 << i;
+  tg->ref++;
+  release(&tg->lock);
+  p->tg = tg;
+  p->tfslot = i;
   return 0;
+}
+
+// Drop p's reference to its thread group, unmapping p's
+// trapframe. The last thread out frees the address space and
+// closes the files, which may sleep if any are open.
+static void
+tgput(struct proc *p)
+{
+  struct tgroup *tg = p->tg;
+
+  p->tg = 0;
+  acquire(&tg->lock);
+  if(tg->ref > 1){
+    uvmunmap(tg->pagetable, TRAPFRAMEN(p->tfslot), 1, 0);
+    tg->tfslots &= ~(1 << p->tfslot);
+    tg->ref--;
+    release(&tg->lock);
+    return;
+  }
+  release(&tg->lock);
+
+  // p was the last thread, so nothing else can reach tg.
+  for(int fd = 0; fd < NOFILE; fd++){
+    if(tg->ofile[fd]){
+      fileclose(tg->ofile[fd]);
+      tg->ofile[fd] = 0;
+    }
+  }
+  if(tg->cwd){
+    begin_op();
+    iput(tg->cwd);
+    end_op();
+    tg->cwd = 0;
+  }
+  uringfree(tg);
+  if(tg->pagetable)
+    proc_freepagetable(tg->pagetable, tg->sz, p->tfslot);
+  tg->pagetable = 0;
+  tg->sz = 0;
+  tg->tfslots = 0;
+  kfree((void*)tg->usyscallpg);
+  tg->usyscallpg = 0;
+  tg->ref = 0;
+  tgfree(tg);
+}
+
+// Allocate an UNUSED proc, with a kernel stack.
+// If found, initialize state required to run in the kernel,
+// and return with p->lock held. If share is not null, the proc
+// is a new thread in that thread group; otherwise it gets a
+// thread group of its own, with no user memory.
+// If there are no free procs, or a memory allocation fails, return 0.
+static struct proc*
+allocproc(struct tgroup *share)
+{
+  struct proc *p;
+
+  if((p = procget()) == 0)
+    return 0;
+  acquire(&p->lock);
+  if(p->state != UNUSED)
+    panic("allocproc");
 
-found:
-  p->pid = allocpid();
+  allocpid(p);
   p->state = USED;
+  p->weight = DEFWEIGHT;
+  p->vruntime = 0;
+  p->cpu = cpuid();
+  p->affinity = ALLCPUS;
+  p->utime = p->stime = p->wtime = 0;
+  p->nvcsw = p->nivcsw = 0;
+  p->rt_period = 0;
   p->tracemask = 0;
-  p->sigalarm_handler = 0;
-  p->sigalarm_is_handler_active = 0;
-  p->sigalarm_period = 0;
-  p->sigalarm_tick_counter = 0;
+  p->sigpending = 0;
+  p->sigmask = 0;
+  memset(p->sighandler, 0, sizeof(p->sighandler));
+  p->insighandler = 0;
+  p->itimer.q = 0;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -136,27 +438,38 @@ found:
     release(&p->lock);
     return 0;
   }
-  if((p->sigalarm_trapframe = (struct trapframe *)kalloc()) == 0){
+  if((p->sigtrapframe = (struct trapframe *)kalloc()) == 0){
     freeproc(p);
     release(&p->lock);
     return 0;
   }
 
-  // Allocate a usyscall page.
-  if((p->usyscallpg = (struct usyscall *)kalloc()) == 0){
-    freeproc(p);
-    release(&p->lock);
-    return 0;
-  }
-  p->usyscallpg->pid = p->pid;
-
-  // An empty user page table.
-  p->pagetable = proc_pagetable(p);
-  if(p->pagetable == 0){
-    freeproc(p);
-    release(&p->lock);
-    return 0;
+  if(share){
+    if(tgjoin(share, p) < 0){
+      freeproc(p);
+      release(&p->lock);
+      return 0;
+    }
+  } else {
+    // A thread group with a usyscall page.
+    if((p->tg = tgalloc()) == 0){
+      freeproc(p);
+      release(&p->lock);
+      return 0;
+    }
+    usyscallinit(p);
+    p->tg->tfslots = 1;
+    p->tfslot = 0;
+
+    // An empty user page table.
+    p->tg->pagetable = proc_pagetable(p);
+    if(p->tg->pagetable == 0){
+      freeproc(p);
+      release(&p->lock);
+      return 0;
+    }
   }
+  p->pagetable = p->tg->pagetable;
 
   // Set up new context to start executing at forkret,
   // which returns to user space.
@@ -168,7 +481,7 @@ found:
 }
 
 // free a proc structure and the data hanging from it,
-// including user pages.
+// including user pages if p is the last thread using them.
 // p->lock must be held.
 static void
 freeproc(struct proc *p)
@@ -176,27 +489,32 @@ freeproc(struct proc *p)
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
-  if(p->usyscallpg)
-    kfree((void*)p->usyscallpg);
-  p->usyscallpg = 0;
-  if(p->pagetable)
-    proc_freepagetable(p->pagetable, p->sz);
+  if(p->sigtrapframe)
+    kfree((void*)p->sigtrapframe);
+  p->sigtrapframe = 0;
+  uprofree(p);
+  // exit() has already let go of the thread group; only a
+  // proc that never ran can still hold one, and it has no
+  // files for tgput() to sleep closing.
+  if(p->tg)
+    tgput(p);
   p->pagetable = 0;
-  p->sz = 0;
+  p->tfslot = 0;
+  if(p->pid)
+    freepid(p);
   p->pid = 0;
   p->parent = 0;
+  p->isthread = 0;
   p->name[0] = 0;
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
-  p->sigalarm_handler = 0;
-  p->sigalarm_is_handler_active = 0;
-  p->sigalarm_period = 0;
   p->state = UNUSED;
+  procput(p);
 }
 
 // Create a user page table for a given process, with no user memory,
-// but with trampoline and trapframe pages.
+// but with trampoline, trapframe and usyscall pages.
 pagetable_t
 proc_pagetable(struct proc *p)
 {
@@ -217,9 +535,9 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
-  // map the trapframe page just below the trampoline page, for
-  // trampoline.S.
-  if(mappages(pagetable, TRAPFRAME, PGSIZE,
+  // map the trapframe page in p's slot beneath the trampoline
+  // page, for trampoline.S.
+  if(mappages(pagetable, TRAPFRAMEN(p->tfslot), PGSIZE,
               (uint64)(p->trapframe), PTE_R | PTE_W) < 0){
     uvmunmap(pagetable, TRAMPOLINE, 1, 0);
     uvmfree(pagetable, 0);
@@ -228,8 +546,9 @@ proc_pagetable(struct proc *p)
 
   // map the usyscall page just below the trapframe page
   if(mappages(pagetable, USYSCALL, PGSIZE,
-              (uint64)(p->usyscallpg), PTE_R | PTE_U) < 0){
-    uvmunmap(pagetable, USYSCALL, 1, 0);
+              (uint64)(p->tg->usyscallpg), PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmunmap(pagetable, TRAPFRAMEN(p->tfslot), 1, 0);
     uvmfree(pagetable, 0);
     return 0;
   }
@@ -238,12 +557,13 @@ proc_pagetable(struct proc *p)
 }
 
 // Free a process's page table, and free the
-// physical memory it refers to.
+// physical memory it refers to. The only trapframe
+// still mapped must be the one in slot tfslot.
 void
-proc_freepagetable(pagetable_t pagetable, uint64 sz)
+proc_freepagetable(pagetable_t pagetable, uint64 sz, int tfslot)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
-  uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, TRAPFRAMEN(tfslot), 1, 0);
   uvmunmap(pagetable, USYSCALL, 1, 0);
   uvmfree(pagetable, sz);
 }
@@ -267,43 +587,88 @@ userinit(void)
 {
   struct proc *p;
 
-  p = allocproc();
+  p = allocproc(0);
   initproc = p;
   
   // allocate one user page and copy initcode's instructions
   // and data into it.
   uvmfirst(p->pagetable, initcode, sizeof(initcode));
-  p->sz = PGSIZE;
+  p->tg->sz = PGSIZE;
 
   // prepare for the very first "return" from kernel to user.
   p->trapframe->epc = 0;      // user program counter
   p->trapframe->sp = PGSIZE;  // user stack pointer
 
   safestrcpy(p->name, "initcode", sizeof(p->name));
-  p->cwd = namei("/");
+  p->tg->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  setrunnable(p);
 
   release(&p->lock);
 }
 
-// Grow or shrink user memory by n bytes.
+// Grow or shrink user memory by n bytes, setting *oldsz
+// to the size before the change.
 // Return 0 on success, -1 on failure.
 int
-growproc(int n)
+growproc(int n, uint64 *oldsz)
 {
   uint64 sz;
   struct proc *p = myproc();
+  struct tgroup *tg = p->tg;
 
-  sz = p->sz;
+  acquire(&tg->lock);
+  sz = *oldsz = tg->sz;
   if(n > 0){
-    if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
+    // keep clear of the uring page and the threads' trapframes.
+    if(sz + n > URING ||
+       (sz = uvmalloc(tg->pagetable, sz, sz + n, PTE_W)) == 0) {
+      release(&tg->lock);
       return -1;
     }
   } else if(n < 0){
-    sz = uvmdealloc(p->pagetable, sz, sz + n);
+    if(sz + n > sz){
+      release(&tg->lock);
+      return -1;
+    }
+    release(&tg->lock);
+    return shrinkproc(tg, sz + n);
+  }
+  tg->sz = sz;
+  release(&tg->lock);
+  return 0;
+}
+
+// Shrink tg's memory to newsz. The other threads may be running
+// on other cpus, whose TLBs can still map the pages; so unmap
+// them a batch at a time, and free each batch only after
+// tlbshootdown(), which can't be called with tg->lock held.
+static int
+shrinkproc(struct tgroup *tg, uint64 newsz)
+{
+  uint64 *pa, va;
+  int i, n;
+
+  if((pa = (uint64*)kalloc()) == 0)
+    return -1;
+  for(;;){
+    acquire(&tg->lock);
+    va = PGROUNDUP(tg->sz);
+    for(n = 0; n < PGSIZE/sizeof(uint64) && va > PGROUNDUP(newsz); n++){
+      va -= PGSIZE;
+      pa[n] = walkaddr(tg->pagetable, va);
+      uvmunmap(tg->pagetable, va, 1, 0);
+    }
+    if(tg->sz > newsz)
+      tg->sz = va > PGROUNDUP(newsz) ? va : newsz;
+    release(&tg->lock);
+    if(n == 0)
+      break;
+    tlbshootdown(tg);
+    for(i = 0; i < n; i++)
+      kfree((void*)pa[i]);
   }
-  p->sz = sz;
+  kfree(pa);
   return 0;
 }
 
@@ -317,17 +682,25 @@ fork(void)
   struct proc *p = myproc();
 
   // Allocate process.
-  if((np = allocproc()) == 0){
+  if((np = allocproc(0)) == 0){
     return -1;
   }
 
-  // Copy user memory from parent to child.
-  if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+  // Copy user memory from parent to child, and share its
+  // open files; other threads may be changing them.
+  acquire(&p->tg->lock);
+  if(uvmcopy(p->pagetable, np->pagetable, p->tg->sz) < 0){
+    release(&p->tg->lock);
     freeproc(np);
     release(&np->lock);
     return -1;
   }
-  np->sz = p->sz;
+  np->tg->sz = p->tg->sz;
+  for(i = 0; i < NOFILE; i++)
+    if(p->tg->ofile[i])
+      np->tg->ofile[i] = filedup(p->tg->ofile[i]);
+  np->tg->cwd = idup(p->tg->cwd);
+  release(&p->tg->lock);
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -338,12 +711,61 @@ fork(void)
   // Copy trace mask of parent to the child
   np->tracemask = p->tracemask;
 
-  // increment reference counts on open file descriptors.
-  for(i = 0; i < NOFILE; i++)
-    if(p->ofile[i])
-      np->ofile[i] = filedup(p->ofile[i]);
-  np->cwd = idup(p->cwd);
+  // The child gets the same CPU share and CPUs as its parent,
+  // and the same signal handlers and mask, but no itimer.
+  np->weight = p->weight;
+  np->affinity = p->affinity;
+  memmove(np->sighandler, p->sighandler, sizeof(p->sighandler));
+  np->sigmask = p->sigmask;
+
+  safestrcpy(np->name, p->name, sizeof(p->name));
+
+  pid = np->pid;
+
+  release(&np->lock);
+
+  // uvmcopy() made the parent's pages read-only, but the other
+  // threads' harts may still have writable TLB entries for them,
+  // and would write into pages the child now shares.
+  if(p->tg->ref > 1)
+    tlbshootdown(p->tg);
+
+  acquire(&wait_lock);
+  addchild(p, np);
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  setrunnable(np);
+  release(&np->lock);
+
+  return pid;
+}
+
+// Create a thread that shares this process's memory and
+// files, and starts at fn(arg) on the given user stack.
+// fn must not return; the thread ends by calling exit().
+int
+clone(uint64 fn, uint64 arg, uint64 stack)
+{
+  int pid;
+  struct proc *np;
+  struct proc *p = myproc();
+
+  if((np = allocproc(p->tg)) == 0){
+    return -1;
+  }
+
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->a0 = arg;
+  np->trapframe->sp = stack & ~0xfUL;  // riscv sp must be 16-byte aligned
+  np->trapframe->ra = 0;
 
+  np->tracemask = p->tracemask;
+  np->weight = p->weight;
+  np->affinity = p->affinity;
+  memmove(np->sighandler, p->sighandler, sizeof(p->sighandler));
+  np->sigmask = p->sigmask;
   safestrcpy(np->name, p->name, sizeof(p->name));
 
   pid = np->pid;
@@ -351,29 +773,82 @@ fork(void)
   release(&np->lock);
 
   acquire(&wait_lock);
-  np->parent = p;
+  addchild(p, np);
+  np->isthread = 1;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  setrunnable(np);
+  release(&np->lock);
+
+  return pid;
+}
+
+// Create a thread that shares this process's memory and files
+// but runs fn() in the kernel, never returning to user space;
+// fn must first release p->lock, as forkret() does, and must
+// exit() once killed(), as it will be when the process exits.
+// init is its parent, so that it doesn't show up in wait() or
+// join(), and reaps it.
+int
+kthread(void (*fn)(void), char *name)
+{
+  int pid;
+  struct proc *np;
+  struct proc *p = myproc();
+
+  if((np = allocproc(p->tg)) == 0){
+    return -1;
+  }
+  np->context.ra = (uint64)fn;
+  np->weight = p->weight;
+  np->affinity = p->affinity;
+  safestrcpy(np->name, name, sizeof(np->name));
+
+  pid = np->pid;
+
+  release(&np->lock);
+
+  acquire(&wait_lock);
+  addchild(initproc, np);
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  setrunnable(np);
   release(&np->lock);
 
   return pid;
 }
 
+// Make p a child of parent.
+// Caller must hold wait_lock.
+static void
+addchild(struct proc *parent, struct proc *p)
+{
+  p->parent = parent;
+  p->sibling = parent->children;
+  parent->children = p;
+}
+
 // Pass p's abandoned children to init.
 // Caller must hold wait_lock.
 void
 reparent(struct proc *p)
 {
-  struct proc *pp;
+  struct proc *pp, *last;
 
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
-      pp->parent = initproc;
-      wakeup(initproc);
-    }
+  if(p->children == 0)
+    return;
+  for(pp = p->children; pp; pp = pp->sibling){
+    // init reaps threads too, with wait().
+    pp->parent = initproc;
+    pp->isthread = 0;
+    last = pp;
   }
+  last->sibling = initproc->children;
+  initproc->children = p->children;
+  p->children = 0;
+  wakeproc(initproc, initproc);
 }
 
 // Exit the current process.  Does not return.
@@ -387,19 +862,30 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
-  // Close all open files.
-  for(int fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd]){
-      struct file *f = p->ofile[fd];
-      fileclose(f);
-      p->ofile[fd] = 0;
+  // The thread that created the thread group takes
+  // the others with it.
+  if(p->tfslot == 0 && p->tg->ref > 1){
+    for(struct proc *pp = allproc; pp; pp = pp->allnext){
+      if(pp == p)
+        continue;
+      acquire(&pp->lock);
+      if(pp->tg == p->tg){
+        pp->killed = 1;
+        if(pp->state == SLEEPING)
+          setrunnable(pp);
+      }
+      release(&pp->lock);
     }
   }
 
-  begin_op();
-  iput(p->cwd);
-  end_op();
-  p->cwd = 0;
+  // Stop the itimer, which would otherwise signal
+  // whatever proc is next allocated here.
+  timer_cancel(&p->itimer);
+
+  // Let go of memory and, if no other thread is
+  // using them, close all open files.
+  tgput(p);
+  p->pagetable = 0;
 
   acquire(&wait_lock);
 
@@ -407,12 +893,24 @@ exit(int status)
   reparent(p);
 
   // Parent might be sleeping in wait().
-  wakeup(p->parent);
+  wakeproc(p->parent, p->parent);
+  if(!p->isthread){
+    acquire(&p->parent->lock);
+    sigpost(p->parent, SIGCHLD);
+    release(&p->parent->lock);
+  }
   
   acquire(&p->lock);
 
   p->xstate = status;
   p->state = ZOMBIE;
+  if(p->rt_period){
+    acquire(&rt_lock);
+    cpus[p->cpu].rtutil -= p->rt_util;
+    release(&rt_lock);
+    p->rt_period = 0;
+  }
+  __sync_fetch_and_sub(&nactive, 1);
 
   release(&wait_lock);
 
@@ -421,22 +919,24 @@ exit(int status)
   panic("zombie exit");
 }
 
-// Wait for a child process to exit and return its pid.
-// Return -1 if this process has no children.
-int
-wait(uint64 addr)
+// Wait for a child to exit and return its pid: a thread
+// from clone() if thread is set, else a process from fork(),
+// and either any such child or the one with the given pid.
+// Return -1 if this process has no such children.
+static int
+waitchild(int thread, int which, uint64 addr)
 {
-  struct proc *pp;
+  struct proc *pp, **cp;
   int havekids, pid;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
+    // Scan through our children looking for exited ones.
     havekids = 0;
-    for(pp = proc; pp < &proc[NPROC]; pp++){
-      if(pp->parent == p){
+    for(cp = &p->children; (pp = *cp) != 0; cp = &pp->sibling){
+      if(pp->isthread == thread && (which == 0 || pp->pid == which)){
         // make sure the child isn't still in exit() or swtch().
         acquire(&pp->lock);
 
@@ -450,6 +950,8 @@ wait(uint64 addr)
             release(&wait_lock);
             return -1;
           }
+          *cp = pp->sibling;
+          pp->sibling = 0;
           freeproc(pp);
           release(&pp->lock);
           release(&wait_lock);
@@ -460,7 +962,7 @@ wait(uint64 addr)
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || killed(p)){
+    if(!havekids || interrupted(p)){
       release(&wait_lock);
       return -1;
     }
@@ -470,66 +972,593 @@ wait(uint64 addr)
   }
 }
 
-// Per-CPU process scheduler.
-// Each CPU calls scheduler() after setting itself up.
-// Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
-//  - swtch to start running that process.
-//  - eventually that process transfers control
-//    via swtch back to the scheduler.
-void
-scheduler(void)
+// Wait for a child process to exit and return its pid.
+// Return -1 if this process has no children.
+int
+wait(uint64 addr)
 {
-  struct proc *p;
-  struct cpu *c = mycpu();
+  return waitchild(0, 0, addr);
+}
 
-  c->proc = 0;
-  for(;;){
-    // The most recent process to run may have had interrupts
-    // turned off; enable them to avoid a deadlock if all
-    // processes are waiting.
-    intr_on();
+// Wait for the thread with the given pid, or any thread
+// if pid is 0, that this thread clone()d to exit, and
+// return its pid.
+// Return -1 if there is no such thread.
+int
+join(int pid, uint64 addr)
+{
+  return waitchild(1, pid, addr);
+}
 
-    int found = 0;
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
+#ifdef SCHED_FAIR
+// Insert p into c's runq, keeping the runq sorted by vruntime.
+// Caller must hold p->lock.
+static void
+runq_insert(struct cpu *c, struct proc *p)
+{
+  struct runq *rq = &c->rq;
+  struct proc **pp;
+
+  acquire(&rq->lock);
+  // a process that slept for a long time must not be
+  // able to monopolize the cpu while it catches up.
+  if(p->vruntime < rq->min_vruntime)
+    p->vruntime = rq->min_vruntime;
+  for(pp = &rq->head; *pp && (*pp)->vruntime <= p->vruntime; pp = &(*pp)->rqnext)
+    ;
+  p->rqnext = *pp;
+  *pp = p;
+  rq->n++;
+  p->cpu = c - cpus;
+  release(&rq->lock);
+}
 
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-        found = 1;
-      }
-      release(&p->lock);
-    }
-    if(found == 0) {
-      // nothing to run; stop running on this core until an interrupt.
-      intr_on();
-      asm volatile("wfi");
+// Remove and return the lowest-vruntime process on rq,
+// or 0 if rq is empty. If thief is not null, the process
+// is about to move to that cpu, so take the first one whose
+// affinity allows it and leave its vruntime relative to
+// rq's min_vruntime.
+static struct proc*
+runq_pop(struct runq *rq, struct cpu *thief)
+{
+  struct proc *p, **pp;
+
+  acquire(&rq->lock);
+  pp = &rq->head;
+  // a queued process's affinity only changes while it is
+  // off the runq (see setaffinity()), so the rq lock is
+  // enough to read it here.
+  if(thief)
+    while(*pp && ((*pp)->affinity & (1 << (thief - cpus))) == 0)
+      pp = &(*pp)->rqnext;
+  if((p = *pp) != 0){
+    *pp = p->rqnext;
+    p->rqnext = 0;
+    rq->n--;
+    if(thief)
+      p->vruntime -= rq->min_vruntime;
+    else if(p->vruntime > rq->min_vruntime)
+      rq->min_vruntime = p->vruntime;
+  }
+  release(&rq->lock);
+  return p;
+}
+
+// Take p off the runq that holds it, if any.
+// Returns 0 if p was not queued: a scheduler has already
+// popped it and is about to run it.
+// Caller must hold p->lock.
+static int
+runq_remove(struct proc *p)
+{
+  struct runq *rq = &cpus[p->cpu].rq;
+  struct proc **pp;
+  int found = 0;
+
+  acquire(&rq->lock);
+  for(pp = &rq->head; *pp; pp = &(*pp)->rqnext){
+    if(*pp == p){
+      *pp = p->rqnext;
+      p->rqnext = 0;
+      rq->n--;
+      found = 1;
+      break;
     }
   }
+  release(&rq->lock);
+  return found;
 }
 
-// Switch to scheduler.  Must hold only p->lock
-// and have changed proc->state. Saves and restores
-// intena because intena is a property of this
-// kernel thread, not this CPU. It should
-// be proc->intena and proc->noff, but that would
-// break in the few places where a lock is held but
-// there's no process.
-void
-sched(void)
+// Called by an idle cpu: take the next process
+// from the cpu with the longest runq.
+static struct proc*
+runq_steal(struct cpu *c)
 {
-  int intena;
-  struct proc *p = myproc();
+  struct cpu *busiest, *o;
+  struct proc *p;
 
-  if(!holding(&p->lock))
+  busiest = 0;
+  for(o = cpus; o < &cpus[NCPU]; o++){
+    // unlocked peek at n; runq_pop() copes with a stale answer.
+    if(o != c && o->rq.n > 0 && (busiest == 0 || o->rq.n > busiest->rq.n))
+      busiest = o;
+  }
+  if(busiest == 0 || (p = runq_pop(&busiest->rq, c)) == 0)
+    return 0;
+  p->vruntime += c->rq.min_vruntime;
+  return p;
+}
+
+// The cpu whose runq p should join: the one it last ran
+// on if its affinity allows, else the allowed cpu with the
+// shortest runq.
+// Caller must hold p->lock.
+static struct cpu*
+runq_choose(struct proc *p)
+{
+  struct cpu *c, *best;
+
+  if(p->affinity & (1 << p->cpu))
+    return &cpus[p->cpu];
+  best = 0;
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if((p->affinity & onlinecpus & (1 << (c - cpus))) == 0)
+      continue;
+    if(best == 0 || c->rq.n < best->rq.n)
+      best = c;
+  }
+  if(best == 0)
+    panic("runq_choose");
+  return best;
+}
+#endif
+
+// Real-time processes are scheduled earliest deadline first,
+// ahead of all others, each on the cpu that setrt() placed it
+// on. A real-time process gets rt_runtime cycles of cpu in each
+// rt_period, to be used by rt_deadline cycles into the period;
+// setrt() keeps the sum of rt_runtime/rt_period on a cpu within
+// RTMAXUTIL percent, which EDF can always meet. A process that
+// uses up its budget sleeps until its next period (rtthrottle()),
+// so that an overrun can't take time reserved by the others.
+
+// Insert p into c's real-time queue, keeping it sorted by
+// deadline.
+// Caller must hold p->lock.
+static void
+rtq_insert(struct cpu *c, struct proc *p)
+{
+  struct runq *rq = &c->rt;
+  struct proc **pp;
+
+  acquire(&rq->lock);
+  for(pp = &rq->head; *pp && (*pp)->rt_absdl <= p->rt_absdl; pp = &(*pp)->rqnext)
+    ;
+  p->rqnext = *pp;
+  *pp = p;
+  rq->n++;
+  release(&rq->lock);
+}
+
+// Remove and return the earliest-deadline process on c's
+// real-time queue, or 0 if there is none.
+static struct proc*
+rtq_pop(struct cpu *c)
+{
+  struct runq *rq = &c->rt;
+  struct proc *p;
+
+  // unlocked peek, so that the common case of no real-time
+  // processes costs no lock.
+  if(rq->n == 0)
+    return 0;
+  acquire(&rq->lock);
+  if((p = rq->head) != 0){
+    rq->head = p->rqnext;
+    p->rqnext = 0;
+    rq->n--;
+  }
+  release(&rq->lock);
+  return p;
+}
+
+// Take p off the real-time queue that holds it, if any.
+// Returns 0 if p was not queued.
+// Caller must hold p->lock.
+static int
+rtq_remove(struct proc *p)
+{
+  struct runq *rq = &cpus[p->cpu].rt;
+  struct proc **pp;
+  int found = 0;
+
+  acquire(&rq->lock);
+  for(pp = &rq->head; *pp; pp = &(*pp)->rqnext){
+    if(*pp == p){
+      *pp = p->rqnext;
+      p->rqnext = 0;
+      rq->n--;
+      found = 1;
+      break;
+    }
+  }
+  release(&rq->lock);
+  return found;
+}
+
+// If a new period has begun since p's current one, start p's
+// budget and deadline over for the latest, keeping to the grid
+// of periods that setrt() began.
+// Caller must hold p->lock.
+static void
+rtreplenish(struct proc *p, uint64 now)
+{
+  if(now < p->rt_release + p->rt_period)
+    return;
+  p->rt_release = now - (now - p->rt_release) % p->rt_period;
+  p->rt_absdl = p->rt_release + p->rt_deadline;
+  p->rt_budget = p->rt_runtime;
+}
+
+// Interrupt another cpu to run p, which has just been queued on
+// c, if c is idle; or if c is busy, an idle cpu that may run p
+// (and that steals it, under SCHED_FAIR). Otherwise a cpu
+// sleeping in wfi would not look for p until its next timer
+// interrupt. A real-time p must run on c, and preempts an
+// ordinary process there; see ipiintr().
+// Caller must hold p->lock.
+static void
+kick(struct proc *p, struct cpu *c)
+{
+  struct proc *running;
+  int me = cpuid();
+
+  // this cpu is about to be handed to p; see wakeupsync().
+  if(cpus[me].handoff == p)
+    return;
+  // order the queueing before the looks at cpu->proc. a cpu
+  // clears its proc before it looks at its queues.
+  __sync_synchronize();
+  if(c - cpus != me){
+    running = c->proc;
+    if(running == 0 || (p->rt_period && running->rt_period == 0)){
+      ipisend(c - cpus);
+      return;
+    }
+  }
+  if(p->rt_period)
+    return;
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(c - cpus != me && c->proc == 0 &&
+       (p->affinity & onlinecpus & (1 << (c - cpus)))){
+      ipisend(c - cpus);
+      return;
+    }
+  }
+}
+
+// Mark p RUNNABLE and make it visible to the scheduler.
+// Caller must hold p->lock.
+static void
+setrunnable(struct proc *p)
+{
+  uint64 now = r_time();
+
+  if(p->state != RUNNABLE){
+    p->readytime = now;
+    __sync_fetch_and_add(&nactive, 1);
+  }
+  p->state = RUNNABLE;
+  if(p->rt_period){
+    rtreplenish(p, now);
+    rtq_insert(&cpus[p->cpu], p);
+    kick(p, &cpus[p->cpu]);
+    return;
+  }
+#ifdef SCHED_FAIR
+  runq_insert(runq_choose(p), p);
+#endif
+  kick(p, &cpus[p->cpu]);
+}
+
+// Take RUNNABLE p off whichever queue holds it, so that it
+// can be requeued with setrunnable(). Returns 0 if p was not
+// queued: a scheduler has already popped it and will requeue
+// it after it runs.
+// Caller must hold p->lock.
+static int
+dequeue(struct proc *p)
+{
+  if(p->rt_period)
+    return rtq_remove(p);
+#ifdef SCHED_FAIR
+  return runq_remove(p);
+#else
+  return 1;  // scheduler() finds it in allproc.
+#endif
+}
+
+// Account for p being given c, p->lock held.
+static void
+schedin(struct proc *p, struct cpu *c)
+{
+  uint64 now = r_time();
+
+  p->wtime += now - p->readytime;
+  p->tstamp = now;
+  p->runstart = now;
+  p->cpu = c - cpus;
+  kstat_add(kscswitch, 1);
+}
+
+// Account for p giving up its cpu, p->lock held. A proc
+// that comes back RUNNABLE was preempted or yielded; one
+// that comes back SLEEPING gave up the cpu voluntarily.
+static void
+schedout(struct proc *p)
+{
+  uint64 now = r_time();
+
+  p->stime += now - p->tstamp;
+  p->tstamp = now;
+  if(p->rt_period){
+    uint64 ran = now - p->runstart;
+    p->rt_budget = ran < p->rt_budget ? p->rt_budget - ran : 0;
+  }
+  if(p->state == RUNNABLE){
+    p->nivcsw++;
+    p->readytime = now;
+  } else if(p->state == SLEEPING)
+    p->nvcsw++;
+}
+
+// Run real-time p on c until it gives the cpu back, with
+// stimecmp set to preempt it when its budget runs out. One
+// with no budget left is still in the kernel, on its way to
+// rtthrottle(); give it RTMINSLICE to get there.
+// Caller must hold p->lock.
+static void
+rtrun(struct cpu *c, struct proc *p)
+{
+  p->state = RUNNING;
+  schedin(p, c);
+  c->proc = p;
+  c->quantum_end = p->runstart + (p->rt_budget > 0 ? p->rt_budget : RTMINSLICE);
+  clockarm();
+  kstacksync(c);
+  swtch(&c->context, &p->context);
+
+  schedout(p);
+  c->proc = 0;
+  if(p->state == RUNNABLE)
+    setrunnable(p);
+}
+
+// Run c's real-time processes, earliest deadline first,
+// until none is left RUNNABLE. Returns 1 if any ran.
+static int
+rtsched(struct cpu *c)
+{
+  struct proc *p;
+  int ran = 0;
+
+  while((p = rtq_pop(c)) != 0){
+    acquire(&p->lock);
+    if(p->state == RUNNABLE){
+      if(p->rt_period && p->cpu == c - cpus)
+        rtrun(c, p);
+      else
+        setrunnable(p);  // setrt() changed it after we popped it.
+      ran = 1;
+    }
+    release(&p->lock);
+  }
+  return ran;
+}
+
+// Run ordinary process p on c until it gives the cpu back, for
+// at most a quantum.
+// Caller must hold p->lock.
+static void
+run(struct cpu *c, struct proc *p)
+{
+  p->state = RUNNING;
+  schedin(p, c);
+  c->proc = p;
+  c->quantum_end = p->runstart + QUANTUM;
+  clockarm();
+  kstacksync(c);
+  swtch(&c->context, &p->context);
+
+  // Process is done running for now.
+  // It should have changed its p->state before coming back.
+  schedout(p);
+#ifdef SCHED_FAIR
+  p->vruntime += (p->tstamp - p->runstart) * DEFWEIGHT / p->weight;
+#endif
+  c->proc = 0;
+  if(p->state == RUNNABLE){
+    // a handoff is for a process that blocks, not one
+    // that is preempted or yields.
+    c->handoff = 0;
+    setrunnable(p);
+  }
+}
+
+// The process that wakeupsync() handed to c, if it is still
+// waiting to run. Under SCHED_FAIR it is taken off its runq,
+// so that it belongs to c as if runq_pop() had returned it.
+static struct proc*
+handoff(struct cpu *c)
+{
+  struct proc *p = c->handoff;
+
+  if(p == 0)
+    return 0;
+  c->handoff = 0;
+#ifdef SCHED_FAIR
+  acquire(&p->lock);
+  if(p->state != RUNNABLE || p->rt_period || !runq_remove(p)){
+    release(&p->lock);
+    return 0;
+  }
+  release(&p->lock);
+#endif
+  return p;
+}
+
+// Called on the way back to user space: a process that
+// wakeupsync() handed this cpu to, expecting to sleep, is not
+// going to get it. Let an idle cpu have it instead, as kick()
+// would have if it hadn't been handed here.
+void
+handoffcancel(void)
+{
+  struct cpu *c = mycpu();
+  struct proc *p = c->handoff;
+
+  if(p == 0)
+    return;
+  c->handoff = 0;
+  acquire(&p->lock);
+  if(p->state == RUNNABLE)
+    kick(p, &cpus[p->cpu]);
+  release(&p->lock);
+}
+
+#ifdef SCHED_FAIR
+// Per-CPU proportional-share process scheduler.
+// Each CPU calls scheduler() after setting itself up.
+// Scheduler never returns.  It loops, doing:
+//  - run this cpu's real-time processes, if any, with rtsched().
+//  - take the process with the lowest weighted virtual
+//    runtime from this cpu's runq, or steal one from
+//    the busiest other cpu if the runq is empty.
+//  - swtch to start running that process.
+//  - when it comes back, charge the r_time() cycles it
+//    used, scaled by DEFWEIGHT/weight, to its vruntime,
+//    and requeue it if it is still RUNNABLE.
+// Processes with larger weights accumulate vruntime more
+// slowly, so they are picked proportionally more often.
+void
+scheduler(void)
+{
+  struct proc *p;
+  struct cpu *c = mycpu();
+
+  c->proc = 0;
+  __sync_fetch_and_or(&onlinecpus, 1 << cpuid());
+  for(;;){
+    // The most recent process to run may have had interrupts
+    // turned off; enable them to avoid a deadlock if all
+    // processes are waiting. Then look for work with them
+    // off, so that an interrupt that queues a process after
+    // the look still ends the wfi below.
+    intr_on();
+    intr_off();
+
+    if(rtsched(c))
+      continue;
+
+    if((p = handoff(c)) == 0 && (p = runq_pop(&c->rq, 0)) == 0 &&
+       (p = runq_steal(c)) == 0){
+      // nothing to run; stop running on this core until an interrupt.
+      clockarm();
+      asm volatile("wfi");
+      continue;
+    }
+
+    // Once off the runq, p belongs to this cpu; nothing else
+    // changes the state of a RUNNABLE process.
+    acquire(&p->lock);
+    if(p->state != RUNNABLE)
+      panic("scheduler: queued proc not runnable");
+    if((p->affinity & (1 << cpuid())) == 0 || p->rt_period){
+      // setaffinity() or setrt() moved p after we popped it.
+      setrunnable(p);
+      release(&p->lock);
+      continue;
+    }
+    run(c, p);
+    release(&p->lock);
+  }
+}
+#else
+// Per-CPU process scheduler.
+// Each CPU calls scheduler() after setting itself up.
+// Scheduler never returns.  It loops, doing:
+//  - run this cpu's real-time processes, if any, with rtsched().
+//  - choose a process to run.
+//  - swtch to start running that process.
+//  - eventually that process transfers control
+//    via swtch back to the scheduler.
+void
+scheduler(void)
+{
+  struct proc *p, *q;
+  struct cpu *c = mycpu();
+  int mask = 1 << cpuid();
+
+  c->proc = 0;
+  __sync_fetch_and_or(&onlinecpus, mask);
+  for(;;){
+    // The most recent process to run may have had interrupts
+    // turned off; enable them to avoid a deadlock if all
+    // processes are waiting. Then scan with them off, so that
+    // an interrupt that makes a process RUNNABLE after the
+    // scan has passed it still ends the wfi below.
+    intr_on();
+    intr_off();
+
+    int found = 0;
+    for(p = allproc; p; p = p->allnext) {
+      // real-time processes come first, between any two others;
+      // then any process handed to this cpu by wakeupsync().
+      if(rtsched(c))
+        found = 1;
+      while((q = handoff(c)) != 0){
+        acquire(&q->lock);
+        if(q->state == RUNNABLE && q->rt_period == 0 && (q->affinity & mask)){
+          run(c, q);
+          found = 1;
+        }
+        release(&q->lock);
+      }
+      acquire(&p->lock);
+      if(p->state == RUNNABLE && p->rt_period == 0 && (p->affinity & mask)) {
+        // Switch to chosen process.  It is the process's job
+        // to release its lock and then reacquire it
+        // before jumping back to us.
+        run(c, p);
+        found = 1;
+      }
+      release(&p->lock);
+    }
+    if(found == 0) {
+      // nothing to run; stop running on this core until an interrupt.
+      // wfi returns for a pending interrupt even though they
+      // are disabled, and the intr_on() above then takes it.
+      clockarm();
+      asm volatile("wfi");
+    }
+  }
+}
+#endif
+
+// Switch to scheduler.  Must hold only p->lock
+// and have changed proc->state. Saves and restores
+// intena because intena is a property of this
+// kernel thread, not this CPU. It should
+// be proc->intena and proc->noff, but that would
+// break in the few places where a lock is held but
+// there's no process.
+void
+sched(void)
+{
+  int intena;
+  struct proc *p = myproc();
+
+  if(!holding(&p->lock))
     panic("sched p->lock");
   if(mycpu()->noff != 1)
     panic("sched locks");
@@ -598,6 +1627,7 @@ sleep(void *chan, struct spinlock *lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  __sync_fetch_and_sub(&nactive, 1);
 
   sched();
 
@@ -616,15 +1646,83 @@ wakeup(void *chan)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
+  for(p = allproc; p; p = p->allnext) {
+    if(p != myproc()){
+      acquire(&p->lock);
+      if(p->state == SLEEPING && p->chan == chan) {
+        setrunnable(p);
+      }
+      release(&p->lock);
+    }
+  }
+}
+
+// Wake up all processes sleeping on chan, for a caller that
+// expects to sleep soon, e.g. a pipe writer that will wait for
+// the reader's reply. The first one woken that may run on this
+// cpu is queued here and handed the cpu as soon as the caller
+// sleeps, rather than waiting for another cpu's scheduler to
+// notice it. If the caller is preempted instead, the woken
+// process waits its turn here like any other; if it returns to
+// user space, handoffcancel() gives the woken process to an
+// idle cpu. Only for callers that sleep right after.
+// Must be called without any p->lock.
+void
+wakeupsync(void *chan)
+{
+  struct proc *p;
+  int handed = 0;
+
+  push_off();
+  for(p = allproc; p; p = p->allnext) {
+    if(p != myproc()){
+      acquire(&p->lock);
+      if(p->state == SLEEPING && p->chan == chan) {
+        if(!handed && p->rt_period == 0 && (p->affinity & (1 << cpuid()))){
+          // before setrunnable(), so that kick() leaves it be.
+          p->cpu = cpuid();
+          mycpu()->handoff = p;
+          handed = 1;
+        }
+        setrunnable(p);
+      }
+      release(&p->lock);
+    }
+  }
+  pop_off();
+}
+
+// Wake up to n processes sleeping on chan, and
+// return the number woken.
+// Must be called without any p->lock.
+int
+wakeupn(void *chan, int n)
+{
+  struct proc *p;
+  int woken = 0;
+
+  for(p = allproc; p && woken < n; p = p->allnext) {
     if(p != myproc()){
       acquire(&p->lock);
       if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
+        setrunnable(p);
+        woken++;
       }
       release(&p->lock);
     }
   }
+  return woken;
+}
+
+// Wake p if it is sleeping on chan.
+// Must be called without p->lock.
+void
+wakeproc(struct proc *p, void *chan)
+{
+  acquire(&p->lock);
+  if(p->state == SLEEPING && p->chan == chan)
+    setrunnable(p);
+  release(&p->lock);
 }
 
 // Kill the process with the given pid.
@@ -632,23 +1730,44 @@ wakeup(void *chan)
 // to user space (see usertrap() in trap.c).
 int
 kill(int pid)
+{
+  return sigsend(pid, SIGKILL);
+}
+
+// Send sig to the process with the given pid.
+int
+sigsend(int pid, int sig)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
-    }
-    release(&p->lock);
+  if(sig <= 0 || sig >= NSIG)
+    return -1;
+  if((p = findproc(pid)) == 0)
+    return -1;
+  sigpost(p, sig);
+  release(&p->lock);
+  return 0;
+}
+
+// Make sig pending for p, unless p ignores it, and wake p
+// from sleep() if it can take the signal; see signal.c.
+// SIGKILL kills p.
+// Caller must hold p->lock.
+void
+sigpost(struct proc *p, int sig)
+{
+  uint64 h = p->sighandler[sig];
+
+  if(sig == SIGKILL)
+    p->killed = 1;
+  else if(h == SIG_IGN || (h == SIG_DFL && sig == SIGCHLD))
+    return;
+  else
+    p->sigpending |= SIGBIT(sig);
+  if(p->state == SLEEPING && (p->killed || (p->sigpending & ~p->sigmask))){
+    // Wake process from sleep().
+    setrunnable(p);
   }
-  return -1;
 }
 
 void
@@ -670,6 +1789,19 @@ killed(struct proc *p)
   return k;
 }
 
+// Should a sleep in a system call give up and fail, because
+// p has been killed or has a signal to take?
+int
+interrupted(struct proc *p)
+{
+  int r;
+
+  acquire(&p->lock);
+  r = p->killed || (p->sigpending & ~p->sigmask);
+  release(&p->lock);
+  return r;
+}
+
 // Copy to either a user address, or kernel address,
 // depending on usr_dst.
 // Returns 0 on success, -1 on error.
@@ -718,7 +1850,7 @@ procdump(void)
   char *state;
 
   printf("\n");
-  for(p = proc; p < &proc[NPROC]; p++){
+  for(p = allproc; p; p = p->allnext){
     if(p->state == UNUSED)
       continue;
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
@@ -730,11 +1862,283 @@ procdump(void)
   }
 }
 
-// Enable tracing of system calls for this process.
-// For debugging.
-void trace(int mask) {
-    struct proc *p = myproc();
-    printf("trace enabled for process: %d with mask %d\n", p->pid, mask);
-    p -> tracemask = mask;
-    return;
+// Set the proportional-share weight of the process with
+// the given pid. Only the SCHED_FAIR scheduler uses it.
+int
+setweight(int pid, int weight)
+{
+  struct proc *p;
+
+  if(weight < 1 || weight > MAXWEIGHT)
+    return -1;
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->weight = weight;
+  release(&p->lock);
+  return 0;
+}
+
+// Restrict the process with the given pid to the CPUs
+// in mask. Fails if mask names no CPU that is running.
+int
+setaffinity(int pid, int mask)
+{
+  struct proc *p;
+
+  if((mask & onlinecpus) == 0)
+    return -1;
+  if((p = findproc(pid)) == 0)
+    return -1;
+  if(p->rt_period){
+    // setrt() placed p on a cpu that must stay allowed.
+    if((mask & (1 << p->cpu)) == 0){
+      release(&p->lock);
+      return -1;
+    }
+    p->affinity = mask;
+    release(&p->lock);
+    return 0;
+  }
+#ifdef SCHED_FAIR
+  // take p off its runq while changing its affinity, so
+  // that runq_pop() can read affinity under the rq lock.
+  if(p->state == RUNNABLE && runq_remove(p)){
+    p->affinity = mask;
+    setrunnable(p);
+  } else
+#endif
+    p->affinity = mask;
+  release(&p->lock);
+  // move off this cpu now if it is no longer allowed.
+  if(p == myproc()){
+    push_off();
+    int ok = mask & (1 << cpuid());
+    pop_off();
+    if(!ok)
+      yield();
+  }
+  return 0;
+}
+
+// Return the CPU mask of the process with the given pid,
+// or -1 if there is none.
+int
+getaffinity(int pid)
+{
+  struct proc *p;
+  int mask;
+
+  if((p = findproc(pid)) == 0)
+    return -1;
+  mask = p->affinity;
+  release(&p->lock);
+  return mask;
+}
+
+// Make the process with the given pid a real-time process that
+// needs runtime cycles of cpu by deadline cycles into each period,
+// starting now; or an ordinary process again if runtime is 0.
+// Fails if no cpu that p may run on has that much share left.
+int
+setrt(int pid, uint64 runtime, uint64 deadline, uint64 period)
+{
+  struct proc *p;
+  struct cpu *c, *best;
+  uint64 util, max;
+  int queued;
+
+  util = 0;
+  if(runtime != 0){
+    if(runtime > deadline || deadline > period || period > 1000UL*TIMEBASE)
+      return -1;
+    util = (runtime * RTUNIT + period - 1) / period;
+  }
+  if((p = findproc(pid)) == 0)
+    return -1;
+
+  // give back p's old share, then find the cpu with the
+  // least reserved that p may run on and has room for it.
+  acquire(&rt_lock);
+  if(p->rt_period)
+    cpus[p->cpu].rtutil -= p->rt_util;
+  best = 0;
+  if(runtime != 0){
+    max = RTMAXUTIL * RTUNIT / 100;
+    for(c = cpus; c < &cpus[NCPU]; c++){
+      if((p->affinity & onlinecpus & (1 << (c - cpus))) == 0 || c->rtutil + util > max)
+        continue;
+      if(best == 0 || c->rtutil < best->rtutil)
+        best = c;
+    }
+    if(best == 0){
+      if(p->rt_period)
+        cpus[p->cpu].rtutil += p->rt_util;
+      release(&rt_lock);
+      release(&p->lock);
+      return -1;
+    }
+    best->rtutil += util;
+  }
+  release(&rt_lock);
+
+  queued = p->state == RUNNABLE && dequeue(p);
+  p->rt_period = runtime ? period : 0;
+  p->rt_runtime = runtime;
+  p->rt_deadline = deadline;
+  p->rt_util = util;
+  p->rt_release = r_time();
+  p->rt_absdl = p->rt_release + deadline;
+  p->rt_budget = runtime;
+  p->rt_jobdl = p->rt_absdl;
+  if(best)
+    p->cpu = best - cpus;
+  if(queued)
+    setrunnable(p);
+  release(&p->lock);
+
+  // get onto the chosen cpu now.
+  if(p == myproc() && best){
+    push_off();
+    int ok = best == mycpu();
+    pop_off();
+    if(!ok)
+      yield();
+  }
+  return 0;
+}
+
+// End the current period's work of this real-time process,
+// sleeping until its next period. Returns 1 if the work
+// finished after its deadline, 0 if in time, or -1 if this
+// is not a real-time process or it was killed.
+int
+rtyield(void)
+{
+  struct proc *p = myproc();
+  uint64 next;
+  int late;
+
+  acquire(&p->lock);
+  if(p->rt_period == 0){
+    release(&p->lock);
+    return -1;
+  }
+  // the work may have been throttled into a later period.
+  late = r_time() > p->rt_jobdl;
+  next = p->rt_release + p->rt_period;
+  release(&p->lock);
+  if(sleepuntil(next) < 0)
+    return -1;
+  acquire(&p->lock);
+  p->rt_jobdl = p->rt_absdl;
+  release(&p->lock);
+  return late;
+}
+
+// If this real-time process has used up its budget for the
+// period, sleep until the next period begins, and return 1.
+// Called from usertrap() when the budget timer fires.
+int
+rtthrottle(void)
+{
+  struct proc *p = myproc();
+  uint64 next;
+
+  acquire(&p->lock);
+  if(p->rt_period == 0 || r_time() - p->runstart < p->rt_budget){
+    release(&p->lock);
+    return 0;
+  }
+  next = p->rt_release + p->rt_period;
+  release(&p->lock);
+  sleepuntil(next);
+  return 1;
+}
+
+// Sample nactive into loadavg for each LOADFREQ ticks
+// that have passed since the last sample; a tickless
+// kernel may not call here for a while.
+// Caller must hold tickslock for writing.
+void
+loadupdate(uint now)
+{
+  for(; now - loadticks >= LOADFREQ; loadticks += LOADFREQ){
+    uint64 n = (uint64)nactive * FIXED_1;
+    for(int i = 0; i < 3; i++)
+      loadavg[i] = (loadavg[i] * loadexp[i] + n * (FIXED_1 - loadexp[i])) >> FSHIFT;
+  }
+}
+
+// The 1, 5 and 15 minute load averages, times 100.
+void
+getloadavg(int *avg)
+{
+  uint seq;
+
+  // a tickless kernel may owe some samples.
+  if(uptime() - loadticks >= LOADFREQ){
+    writeseqlock(&tickslock);
+    tickupdate();
+    writesequnlock(&tickslock);
+  }
+  do{
+    seq = readseqbegin(&tickslock);
+    for(int i = 0; i < 3; i++)
+      avg[i] = (loadavg[i] * 100 + FIXED_1/2) >> FSHIFT;
+  } while(readseqretry(&tickslock, seq));
+}
+
+static void
+fillschedstat(struct proc *p, struct schedstat *st)
+{
+  st->pid = p->pid;
+  st->state = p->state;
+  safestrcpy(st->name, p->name, sizeof(st->name));
+  st->utime = p->utime;
+  st->stime = p->stime;
+  st->wtime = p->wtime;
+  // a running proc is charged at its next trap or switch,
+  // but a waiting one only when it gets a cpu.
+  if(p->state == RUNNABLE)
+    st->wtime += r_time() - p->readytime;
+  st->nvcsw = p->nvcsw;
+  st->nivcsw = p->nivcsw;
+  st->cpu = p->cpu;
+  st->weight = p->weight;
+}
+
+// Copy out the scheduler statistics of the process with the
+// given pid, or of up to n processes if pid is 0, to the
+// array at user address addr. Returns the number copied.
+int
+schedstat(int pid, uint64 addr, int n)
+{
+  struct proc *p;
+  struct schedstat st;
+  int i;
+
+  if(pid != 0){
+    if(n < 1 || (p = findproc(pid)) == 0)
+      return -1;
+    fillschedstat(p, &st);
+    release(&p->lock);
+    if(copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st)) < 0)
+      return -1;
+    return 1;
+  }
+
+  i = 0;
+  for(p = allproc; p && i < n; p = p->allnext){
+    acquire(&p->lock);
+    if(p->state == UNUSED){
+      release(&p->lock);
+      continue;
+    }
+    fillschedstat(p, &st);
+    release(&p->lock);
+    if(copyout(myproc()->pagetable, addr + i*sizeof(st), (char*)&st, sizeof(st)) < 0)
+      return -1;
+    i++;
+  }
+  return i;
 }
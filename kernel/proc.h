@@ -18,13 +18,35 @@ struct context {
   uint64 s11;
 };
 
-// Per-CPU state.
+// Per-CPU queue of RUNNABLE processes for the proportional-share
+// scheduler (SCHED_FAIR), kept sorted by weighted virtual runtime.
+struct runq {
+  struct spinlock lock __attribute__((aligned(CACHELINE))); // Other harts queue here
+  struct proc *head;          // Lowest vruntime first, linked through rqnext.
+  int n;                      // Number of queued processes.
+  uint64 min_vruntime;        // Never decreases; floor for newly queued procs.
+};
+
+// Per-CPU state. Each cpu's starts on a cache line of its own,
+// and its run queues, which other harts lock to queue processes
+// here, each start another; the rest is written by this cpu alone.
 struct cpu {
   struct proc *proc;          // The process running on this cpu, or null.
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
-};
+  struct runq rq;             // Runnable processes (SCHED_FAIR only).
+  struct runq rt;             // Runnable real-time processes, by deadline.
+  uint64 rtutil;              // Share reserved by real-time processes here.
+  uint64 quantum_end;         // r_time() at which proc should be preempted.
+  struct proc *handoff;       // Run next if proc sleeps; see wakeupsync().
+#ifdef LOCK_MCS
+  struct mcsnode mcs[NMCSNODE]; // Queue nodes for the locks held or awaited.
+#endif
+  uint kstackgen;             // kstackgen as of this cpu's last TLB flush.
+  uint64 profnext;            // r_time() of the next profiling sample.
+  int profdue;                // Take a sample on the way out of this trap.
+} __attribute__((aligned(CACHELINE)));
 
 extern struct cpu cpus[NCPU];
 
@@ -81,35 +103,92 @@ struct trapframe {
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
-// Per-process state
+// State shared by the threads of a process: the address space,
+// open files and current directory. fork() gives the child a
+// copy; clone() gives the new thread a reference.
+struct tgroup {
+  struct spinlock lock;
+  int ref;                     // Number of threads; lock protects
+  int tfslots;                 // Trapframe slots in use, a bit per thread; lock protects
+  uint64 sz;                   // Size of process memory (bytes); lock protects changes
+  pagetable_t pagetable;       // User page table
+  struct usyscall *usyscallpg; // Page for speeding up system call
+  struct uringstate *uring;    // uring_setup()'s rings, or 0
+  struct file *ofile[NOFILE];  // Open files; lock protects changes
+  struct inode *cwd;           // Current directory; lock protects changes
+  struct tgroup *freenext;     // Next unused tgroup; proc_lock protects
+};
+
+// Per-process state, laid out in three parts, each starting on
+// a cache line of its own: what any hart may write as it wakes,
+// queues or schedules p; what only the hart running p writes, on
+// every trap and switch; and what is seldom touched. So wakeup()
+// scanning every proc, or another hart queueing p, doesn't take
+// lines away from the hart that is running it.
 struct proc {
+  // hot, and written by any hart.
   struct spinlock lock;
 
   // p->lock must be held when using these:
   enum procstate state;        // Process state
   void *chan;                  // If non-zero, sleeping on chan
   int killed;                  // If non-zero, have been killed
-  int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int cpu;                     // CPU whose runq holds p, or that last ran p
+  int affinity;                // Mask of CPUs p may run on
+  int weight;                  // CPU share, relative to DEFWEIGHT
+  uint sigpending;             // Signals posted but not yet delivered
+  uint64 vruntime;             // Run time scaled by DEFWEIGHT/weight
+  uint64 runstart;             // r_time() when last given a CPU
+  uint64 readytime;            // r_time() when last made RUNNABLE
+  uint64 wtime;                // r_time() cycles RUNNABLE, waiting for a CPU
+  uint nvcsw;                  // Times p gave up the CPU to sleep
+  uint nivcsw;                 // Times p was preempted or yielded
+  uint64 rt_period;            // Real-time period, or 0 if p is not real-time
+  struct proc *rqnext;         // Next in cpu's runq; runq lock protects
+  struct proc *allnext;        // Next in allproc; never changes once set
 
-  // wait_lock must be held when using this:
-  struct proc *parent;         // Parent process
-
-  // these are private to the process, so p->lock need not be held.
-  uint64 kstack;               // Virtual address of kernel stack
-  uint64 sz;                   // Size of process memory (bytes)
-  pagetable_t pagetable;       // User page table
+  // hot, and private to the process, so p->lock need not be held.
+  uint64 kstack __attribute__((aligned(CACHELINE))); // Virtual address of kernel stack
+  uint64 utime;                // r_time() cycles run in user space
+  uint64 stime;                // r_time() cycles run in the kernel
+  uint64 tstamp;               // r_time() when utime or stime was last charged
+  struct tgroup *tg;           // Memory and files, shared with other threads
+  pagetable_t pagetable;       // User page table, the same as tg->pagetable
   struct trapframe *trapframe; // data page for trampoline.S
+  int tfslot;                  // trapframe is mapped at TRAPFRAMEN(tfslot)
+  uint64 tracemask;            // Mask for tracing system calls
+  struct uprof *uprof;         // User pc histogram, or 0; see uprof.c
+  uint sigmask;                // Signals blocked from delivery
+  int insighandler;            // Running a handler; handlers don't nest
   struct context context;      // swtch() here to run process
-  struct file *ofile[NOFILE];  // Open files
-  struct inode *cwd;           // Current directory
+
+  // cold. p->lock must be held when using these:
+  int xstate __attribute__((aligned(CACHELINE))); // Exit status to be returned to parent's wait
+  uint64 rt_runtime;           // Real-time budget for each period
+  uint64 rt_deadline;          // Deadline, relative to the start of a period
+  uint64 rt_util;              // rt_runtime/rt_period, reserved on cpus[p->cpu]
+  uint64 rt_release;           // r_time() at which the current period began
+  uint64 rt_absdl;             // r_time() deadline of the current period
+  uint64 rt_budget;            // Budget left as of runstart
+  uint64 rt_jobdl;             // Deadline of the work since the last rtyield()
+
+  // wait_lock must be held when using these:
+  struct proc *parent;         // Parent process
+  struct proc *children;       // First child, linked through sibling
+  struct proc *sibling;        // Next child of parent
+  int isthread;                // Made by clone(); reaped by join(), not wait()
+
+  struct proc *pidnext;        // Next in pid hash chain; pid_lock protects
+  struct proc *freenext;       // Next UNUSED proc; proc_lock protects
+
+  // private to the process.
   char name[16];               // Process name (debugging)
-  int tracemask;               // Mask for tracing system calls
-  struct usyscall *usyscallpg; // Page for speeding up system call
 
-  int sigalarm_period;         // The time period for the syscall sigalarm, 0 if sigalarm not active
-  void (*sigalarm_handler)();  // The handler for sigalarm;
-  int sigalarm_tick_counter;   // Counter for number of ticks inside sigalarm
-  char sigalarm_is_handler_active; // 1 if sigalarm handler was called but hasn't returned yet
-  struct trapframe *sigalarm_trapframe; // saved register for sigalarm
+  // signals; see signal.c.
+  uint sigsavedmask;           // sigmask to restore in sigreturn()
+  uint64 sighandler[NSIG];     // Handler address, SIG_DFL or SIG_IGN
+  struct trapframe *sigtrapframe; // Registers for sigreturn() to restore
+  struct timer itimer;         // setitimer()'s timer, which posts SIGALRM
+  uint64 itimer_interval;      // Its period in r_time() cycles, or 0
 };
@@ -0,0 +1,143 @@
+// Kernel PC-sampling profiler.
+//
+// While kprofctl() has profiling on, clockarm() also programs
+// each hart's stimecmp for its next sample, and the timer
+// interrupt marks the sample due (clockintr()). usertrap() and
+// kerneltrap() then record the interrupted pc and, for kernel
+// code, the return addresses found by following the frame
+// pointers, into the hart's ring.
+//
+// Each ring has one producer, its own hart with interrupts
+// off, so the producer takes no lock: it fills the slot at
+// head and then publishes it by advancing head. kprofread()
+// copies a slot out before advancing tail past it. Samples
+// that find the ring full are dropped and counted.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "proc.h"
+#include "kprof.h"
+#include "defs.h"
+
+#define NPROFSAMPLE 256   // per cpu; a power of two
+
+// the hart's and the reader's indexes are on separate cache
+// lines, as are the rings of different harts.
+struct profring {
+  uint head;              // next slot to fill; written by the hart
+  uint dropped;
+  uint tail __attribute__((aligned(CACHELINE))); // next slot to read; written by kprofread()
+  struct kprofsample buf[NPROFSAMPLE];
+} __attribute__((aligned(CACHELINE)));
+
+static struct profring rings[NCPU];
+static struct spinlock proflock;  // serializes kprofread()s
+
+uint64 profinterval;      // r_time() cycles between samples, or 0 if off
+
+void
+profinit(void)
+{
+  initlock(&proflock, "prof");
+}
+
+// Record a sample on this hart. fp is the frame pointer of the
+// interrupted kernel code, or 0 if pc is a user address.
+// Interrupts must be disabled.
+void
+profsample(uint64 pc, uint64 fp)
+{
+  struct cpu *c = mycpu();
+  struct profring *r = &rings[c - cpus];
+  struct kprofsample *s;
+  uint64 lo, hi;
+
+  c->profdue = 0;
+  if(r->head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >= NPROFSAMPLE){
+    r->dropped++;
+    return;
+  }
+  s = &r->buf[r->head % NPROFSAMPLE];
+  s->pc = pc;
+  s->pid = c->proc ? c->proc->pid : 0;
+  s->cpu = c - cpus;
+  s->user = fp == 0;
+  s->depth = 0;
+  // a kernel stack is one page; stop at its edge, as
+  // backtrace() does.
+  lo = PGROUNDDOWN(fp);
+  hi = PGROUNDUP(fp);
+  while(s->depth < KPROFDEPTH && fp >= lo + 16 && fp < hi){
+    s->stack[s->depth++] = *(uint64*)(fp - 8);
+    fp = *(uint64*)(fp - 16);
+  }
+  __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+}
+
+// Sample every TIMEBASE/hz cycles on each hart, or stop if
+// hz is 0. Returns the number of samples dropped since the
+// last call.
+int
+kprofctl(int hz)
+{
+  int dropped = 0;
+
+  if(hz < 0 || hz > 10000)
+    return -1;
+  // harts pick up the new rate when they next arm a timer.
+  profinterval = hz ? TIMEBASE / hz : 0;
+  for(int i = 0; i < NCPU; i++){
+    cpus[i].profnext = 0;
+    dropped += __atomic_exchange_n(&rings[i].dropped, 0, __ATOMIC_RELAXED);
+  }
+  return dropped;
+}
+
+// Copy up to n samples from the harts' rings to the user
+// array at addr, and return the number copied.
+int
+kprofread(uint64 addr, int n)
+{
+  struct proc *p = myproc();
+  struct kprofsample s;
+  struct profring *r;
+  int i, got = 0;
+
+  acquire(&proflock);
+  for(i = 0; i < NCPU && got < n; i++){
+    r = &rings[i];
+    while(got < n && r->tail != __atomic_load_n(&r->head, __ATOMIC_ACQUIRE)){
+      s = r->buf[r->tail % NPROFSAMPLE];
+      __atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+      if(copyout(p->pagetable, addr + got*sizeof(s), (char*)&s, sizeof(s)) < 0){
+        release(&proflock);
+        return -1;
+      }
+      got++;
+    }
+  }
+  release(&proflock);
+  return got;
+}
+
+uint64
+sys_kprofctl(void) {
+  int hz;
+
+  argint(0, &hz);
+  return kprofctl(hz);
+}
+
+uint64
+sys_kprofread(void) {
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return kprofread(addr, n);
+}
@@ -63,6 +63,7 @@ w_sstatus(uint64 x)
 }
 
 // Supervisor Interrupt Pending
+#define SIP_SSIP (1L << 1) // software
 static inline uint64
 r_sip()
 {
@@ -97,6 +98,7 @@ w_sie(uint64 x)
 
 // Machine-mode Interrupt Enable
 #define MIE_STIE (1L << 5)  // supervisor timer
+#define MIE_MSIE (1L << 3)  // machine software
 static inline uint64
 r_mie()
 {
@@ -111,6 +113,19 @@ w_mie(uint64 x)
   asm volatile("csrw mie, %0" : : "r" (x));
 }
 
+// Machine-mode interrupt vector
+static inline void 
+w_mtvec(uint64 x)
+{
+  asm volatile("csrw mtvec, %0" : : "r" (x));
+}
+
+static inline void 
+w_mscratch(uint64 x)
+{
+  asm volatile("csrw mscratch, %0" : : "r" (x));
+}
+
 // supervisor exception program counter, holds the
 // instruction address to which a return from
 // exception will go.
@@ -260,6 +275,22 @@ r_stval()
   return x;
 }
 
+// Supervisor-mode Counter-Enable
+#define SCOUNTEREN_TM (1L << 1) // user mode may read the time CSR
+static inline void 
+w_scounteren(uint64 x)
+{
+  asm volatile("csrw scounteren, %0" : : "r" (x));
+}
+
+static inline uint64
+r_scounteren()
+{
+  uint64 x;
+  asm volatile("csrr %0, scounteren" : "=r" (x) );
+  return x;
+}
+
 // Machine-mode Counter-Enable
 static inline void 
 w_mcounteren(uint64 x)
@@ -0,0 +1,120 @@
+// Reader-writer spin locks and sequence locks.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "rwlock.h"
+#include "riscv.h"
+#include "timer.h"
+#include "proc.h"
+#include "defs.h"
+
+void
+initrwlock(struct rwspinlock *rw, char *name)
+{
+  initlock(&rw->lock, name);
+  rw->state = 0;
+}
+
+// Acquire rw for reading. Readers don't nest: a second
+// acquireread() on one cpu could wait for a writer that
+// waits for the first.
+void
+acquireread(struct rwspinlock *rw)
+{
+  uint64 spins = 0;
+  uint s;
+
+  push_off(); // a writer on this cpu would wait for us forever.
+  for(;;){
+    s = __atomic_load_n(&rw->state, __ATOMIC_RELAXED);
+    if((s & RWWRITER) == 0 &&
+       __atomic_compare_exchange_n(&rw->state, &s, s + 1, 1,
+                                   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+      break;
+    spins++;
+  }
+  // readers count against the lock's name like writers do,
+  // but have no hold time: nobody waits for a reader alone.
+  lockstat_acquire(rw->lock.stat, spins);
+}
+
+void
+releaseread(struct rwspinlock *rw)
+{
+  if((__atomic_load_n(&rw->state, __ATOMIC_RELAXED) & ~RWWRITER) == 0)
+    panic("releaseread");
+  __atomic_fetch_sub(&rw->state, 1, __ATOMIC_RELEASE);
+  pop_off();
+}
+
+// Acquire rw for writing: wait out the other writers, then
+// shut out new readers and wait for the ones inside to leave.
+void
+acquirewrite(struct rwspinlock *rw)
+{
+  acquire(&rw->lock);
+  __atomic_fetch_or(&rw->state, RWWRITER, __ATOMIC_RELAXED);
+  while(__atomic_load_n(&rw->state, __ATOMIC_ACQUIRE) != RWWRITER)
+    ;
+}
+
+void
+releasewrite(struct rwspinlock *rw)
+{
+  __atomic_fetch_and(&rw->state, ~RWWRITER, __ATOMIC_RELEASE);
+  release(&rw->lock);
+}
+
+// Check whether this cpu holds rw for writing.
+int
+holdingwrite(struct rwspinlock *rw)
+{
+  return holding(&rw->lock);
+}
+
+void
+initseqlock(struct seqlock *sl, char *name)
+{
+  initlock(&sl->lock, name);
+  sl->seq = 0;
+}
+
+void
+writeseqlock(struct seqlock *sl)
+{
+  acquire(&sl->lock);
+  __atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELAXED);
+  // readers must not see the update before seq turns odd.
+  __sync_synchronize();
+}
+
+void
+writesequnlock(struct seqlock *sl)
+{
+  __sync_synchronize();
+  __atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELAXED);
+  release(&sl->lock);
+}
+
+// Start a read, returning the sequence number to give
+// readseqretry() at its end. Waits while a write is under way.
+uint
+readseqbegin(struct seqlock *sl)
+{
+  uint seq;
+
+  while((seq = __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE)) & 1)
+    ;
+  return seq;
+}
+
+// Whether a write overlapped the read begun with seq, so that
+// what was read must be thrown away and read again.
+int
+readseqretry(struct seqlock *sl, uint seq)
+{
+  __sync_synchronize();
+  return __atomic_load_n(&sl->seq, __ATOMIC_RELAXED) != seq;
+}
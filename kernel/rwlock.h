@@ -0,0 +1,21 @@
+// Locks for data that is read far more often than written.
+// Both spin, and keep interrupts off while held, like a spinlock.
+
+// Reader-writer spin lock: any number of readers at once, or one
+// writer. A waiting writer keeps new readers out, so a steady
+// stream of readers can't starve it.
+#define RWWRITER 0x80000000
+struct rwspinlock {
+  struct spinlock lock;  // Held by the writer; orders writers
+  uint state;            // Readers holding the lock, | RWWRITER
+                         // while a writer holds or waits for it
+};
+
+// Sequence lock: writers take a spinlock and make seq odd while
+// they work; readers take nothing, and read again if seq was odd
+// or changed under them. Only for data that can be copied out
+// and thrown away, since a reader may see a half-made update.
+struct seqlock {
+  struct spinlock lock;  // Orders writers
+  uint seq;              // Odd while a writer is at work
+};
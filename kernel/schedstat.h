@@ -0,0 +1,14 @@
+// Scheduler statistics for a process, from schedstat().
+// Times are in r_time() cycles, TIMEBASE to the second.
+struct schedstat {
+  int pid;
+  int state;        // enum procstate in proc.h
+  char name[16];
+  uint64 utime;     // running in user space
+  uint64 stime;     // running in the kernel
+  uint64 wtime;     // RUNNABLE, waiting for a cpu
+  uint nvcsw;       // gave up the cpu to sleep
+  uint nivcsw;      // preempted, or yielded
+  int cpu;          // cpu that last ran it
+  int weight;       // proportional share, see setweight()
+};
@@ -0,0 +1,260 @@
+// Signals and interval timers.
+//
+// A signal posted to a process (sigpost() in proc.c) stays
+// pending until the process is on its way back to user space
+// with the signal unblocked; usertrap() then calls sigdeliver(),
+// which either takes the default action or saves the user
+// registers in p->sigtrapframe and enters the handler, which
+// ends by calling sigreturn(). Handlers don't nest: every signal
+// is blocked until sigreturn(). A pending signal also ends a
+// sleep in a system call that checks interrupted(), which then
+// fails, so that the handler can run without delay.
+//
+// setitimer() posts SIGALRM from a timer on the kernel's timer
+// queues (timer.c), once or periodically.
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "proc.h"
+#include "signal.h"
+#include "defs.h"
+
+#define ITIMERMIN (TIMEBASE / 10000)  // shortest period, 100us
+
+// Act on the lowest-numbered pending signal that isn't blocked,
+// if any, as this process returns to user space.
+void
+sigdeliver(void)
+{
+  struct proc *p = myproc();
+  uint pending;
+  uint64 handler;
+  int sig;
+
+  // unlocked peek; sigpost() wakes or interrupts us for
+  // anything that arrives after it.
+  if(p->sigpending == 0)
+    return;
+
+  acquire(&p->lock);
+  pending = p->sigpending & ~p->sigmask;
+  if(pending == 0){
+    release(&p->lock);
+    return;
+  }
+  for(sig = 1; (pending & SIGBIT(sig)) == 0; sig++)
+    ;
+  p->sigpending &= ~SIGBIT(sig);
+  handler = p->sighandler[sig];
+  if(handler == SIG_DFL){
+    // sigpost() drops the signals that are ignored by default.
+    release(&p->lock);
+    exit(-1);
+  }
+  if(handler == SIG_IGN){
+    release(&p->lock);
+    return;
+  }
+  *p->sigtrapframe = *p->trapframe;
+  p->sigsavedmask = p->sigmask;
+  p->sigmask = ~SIGBIT(SIGKILL);
+  p->insighandler = 1;
+  release(&p->lock);
+
+  p->trapframe->epc = handler;
+  p->trapframe->a0 = sig;
+}
+
+// Return from a signal handler to the registers it interrupted.
+// Returns the restored a0, since syscall() stores the return
+// value there.
+uint64
+sigreturn(void)
+{
+  struct proc *p = myproc();
+
+  if(!p->insighandler)
+    return -1;
+  *p->trapframe = *p->sigtrapframe;
+  acquire(&p->lock);
+  p->sigmask = p->sigsavedmask;
+  p->insighandler = 0;
+  release(&p->lock);
+  return p->trapframe->a0;
+}
+
+// Set this process's handler for sig: a user address, SIG_DFL
+// or SIG_IGN. Ignoring a signal discards it if it is pending.
+int
+sigaction(int sig, uint64 handler)
+{
+  struct proc *p = myproc();
+
+  if(sig <= 0 || sig >= NSIG || sig == SIGKILL)
+    return -1;
+  acquire(&p->lock);
+  p->sighandler[sig] = handler;
+  if(handler == SIG_IGN || (handler == SIG_DFL && sig == SIGCHLD))
+    p->sigpending &= ~SIGBIT(sig);
+  release(&p->lock);
+  return 0;
+}
+
+// Change the set of blocked signals, and return the old set.
+// SIGKILL can't be blocked.
+int
+sigprocmask(int how, uint mask)
+{
+  struct proc *p = myproc();
+  uint old;
+
+  mask &= ~SIGBIT(SIGKILL);
+  acquire(&p->lock);
+  old = p->sigmask;
+  if(how == SIG_BLOCK)
+    p->sigmask |= mask;
+  else if(how == SIG_UNBLOCK)
+    p->sigmask &= ~mask;
+  else if(how == SIG_SETMASK)
+    p->sigmask = mask;
+  else
+    old = -1;
+  release(&p->lock);
+  return old;
+}
+
+// Caught signals go back to their default action in exec(),
+// since the handlers were addresses in the old image; and an
+// exec() from a handler leaves the handler for good.
+void
+sigexec(struct proc *p)
+{
+  acquire(&p->lock);
+  for(int i = 0; i < NSIG; i++)
+    if(p->sighandler[i] != SIG_IGN)
+      p->sighandler[i] = SIG_DFL;
+  if(p->insighandler){
+    p->sigmask = p->sigsavedmask;
+    p->insighandler = 0;
+  }
+  release(&p->lock);
+}
+
+// Called from timerintr() with the timer's queue locked.
+static uint64
+itimerfire(struct timer *t)
+{
+  struct proc *p = t->arg;
+  uint64 next;
+
+  acquire(&p->lock);
+  sigpost(p, SIGALRM);
+  release(&p->lock);
+  if(p->itimer_interval == 0)
+    return 0;
+  // don't try to catch up on expirations missed while
+  // this hart had interrupts off; they would coalesce.
+  next = t->deadline + p->itimer_interval;
+  if(next <= r_time())
+    next = r_time() + p->itimer_interval;
+  return next;
+}
+
+// Post SIGALRM to this process value r_time() cycles from now,
+// and then every interval cycles if interval is not 0. A value
+// of 0 stops the timer.
+int
+setitimer(uint64 value, uint64 interval)
+{
+  struct proc *p = myproc();
+
+  if(interval != 0 && interval < ITIMERMIN)
+    return -1;
+  // the timer may be on another hart's queue, and firing now;
+  // timer_cancel() waits for that.
+  timer_cancel(&p->itimer);
+  if(value == 0)
+    return 0;
+  p->itimer_interval = interval;
+  p->itimer.deadline = r_time() + value;
+  p->itimer.fn = itimerfire;
+  p->itimer.arg = p;
+  return timer_add(&p->itimer);
+}
+
+// The original alarm interface: call handler every period
+// ticks, or stop if period is 0.
+int
+sigalarm(int period, uint64 handler)
+{
+  struct proc *p = myproc();
+
+  if(period < 0)
+    return -1;
+  if(period == 0){
+    setitimer(0, 0);
+    acquire(&p->lock);
+    p->sighandler[SIGALRM] = SIG_DFL;
+    p->sigpending &= ~SIGBIT(SIGALRM);
+    release(&p->lock);
+    return 0;
+  }
+  sigaction(SIGALRM, handler);
+  return setitimer((uint64)period * TICKCYCLES, (uint64)period * TICKCYCLES);
+}
+
+uint64
+sys_sigalarm(void) {
+  int n;
+  uint64 p;
+
+  argint(0, &n);
+  argaddr(1, &p);
+  return sigalarm(n, p);
+}
+
+uint64
+sys_sigreturn(void) {
+  return sigreturn();
+}
+
+uint64
+sys_sigaction(void) {
+  int sig;
+  uint64 handler;
+
+  argint(0, &sig);
+  argaddr(1, &handler);
+  return sigaction(sig, handler);
+}
+
+uint64
+sys_sigprocmask(void) {
+  int how, mask;
+
+  argint(0, &how);
+  argint(1, &mask);
+  return sigprocmask(how, mask);
+}
+
+uint64
+sys_sigsend(void) {
+  int pid, sig;
+
+  argint(0, &pid);
+  argint(1, &sig);
+  return sigsend(pid, sig);
+}
+
+// value and interval are in microseconds.
+uint64
+sys_setitimer(void) {
+  uint64 value, interval;
+
+  argaddr(0, &value);
+  argaddr(1, &interval);
+  return setitimer(value * (TIMEBASE / 1000000), interval * (TIMEBASE / 1000000));
+}
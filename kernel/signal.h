@@ -0,0 +1,19 @@
+// Signals, shared by the kernel and user programs.
+// Signal numbers are below NSIG, in param.h.
+#define SIGINT     2
+#define SIGKILL    9   // can't be caught, blocked or ignored
+#define SIGUSR1   10
+#define SIGUSR2   12
+#define SIGALRM   14   // setitimer() expired
+#define SIGTERM   15
+#define SIGCHLD   17   // ignored by default
+
+#define SIG_DFL    0   // default action: terminate, or ignore SIGCHLD
+#define SIG_IGN    1
+
+// sigprocmask() how
+#define SIG_BLOCK   0
+#define SIG_UNBLOCK 1
+#define SIG_SETMASK 2
+
+#define SIGBIT(sig) (1U << (sig))
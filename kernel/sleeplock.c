@@ -1,4 +1,17 @@
 // Sleeping locks
+//
+// A process that finds the lock held spins for a while, if the
+// holder is running on another cpu and nobody is queued, since
+// buffer and inode locks are mostly held briefly; then it joins
+// a queue and sleeps. releasesleep() hands the lock straight to
+// the first in the queue and wakes only that one, so waiters are
+// served in order and don't stampede for the lock.
+//
+// A lock may instead be held shared, by any number of readers at
+// once, with acquiresleepshared(). A reader queues behind anyone
+// already waiting, so a stream of readers can't starve a writer;
+// a writer letting go hands the lock to all the readers at the
+// head of the queue together.
 
 #include "types.h"
 #include "riscv.h"
@@ -6,27 +19,129 @@
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
+#include "timer.h"
 #include "proc.h"
 #include "sleeplock.h"
 
+// A process in a sleeplock's queue. It lives on the waiter's
+// stack, and is the channel that the waiter sleeps on.
+struct sleepwaiter {
+  struct proc *p;
+  struct sleepwaiter *next;
+  int shared;         // p wants the lock shared
+  int granted;        // the lock has been handed to p
+};
+
 void
 initsleeplock(struct sleeplock *lk, char *name)
 {
   initlock(&lk->lk, "sleep lock");
   lk->name = name;
   lk->locked = 0;
+  lk->readers = 0;
+  lk->owner = 0;
+  lk->head = lk->tail = 0;
   lk->pid = 0;
+#ifdef LOCKSTAT
+  lk->stat = lockstat_register(name, 1);
+#endif
+}
+
+// Whether the holder of lk is running, and so may let go soon.
+// No lock: the answer is only a hint.
+static int
+ownerrunning(struct sleeplock *lk)
+{
+  struct proc *o = __atomic_load_n(&lk->owner, __ATOMIC_RELAXED);
+
+  // procs are never freed, so o is safe to look at.
+  return o != 0 && __atomic_load_n(&o->state, __ATOMIC_RELAXED) == RUNNING;
+}
+
+// Join lk's queue, and sleep until the lock is handed to us.
+// Returns the number of sleeps. Caller must hold lk->lk.
+static uint64
+waitsleep(struct sleeplock *lk, int shared)
+{
+  struct sleepwaiter w;
+  uint64 sleeps = 0;
+
+  w.p = myproc();
+  w.next = 0;
+  w.shared = shared;
+  w.granted = 0;
+  if(lk->tail)
+    lk->tail->next = &w;
+  else
+    lk->head = &w;
+  lk->tail = &w;
+  while(!w.granted){
+    sleep(&w, &lk->lk);
+    sleeps++;
+  }
+  return sleeps;
+}
+
+// Hand lk, which nobody holds, to the waiters at the head of
+// its queue: the first, if it wants the lock to itself, or else
+// every reader up to the first that does. Caller must hold lk->lk.
+static void
+grant(struct sleeplock *lk)
+{
+  struct sleepwaiter *w;
+  int shared;
+
+  while((w = lk->head) != 0){
+    shared = w->shared;
+    if(!shared && lk->readers > 0)
+      break;
+    if((lk->head = w->next) == 0)
+      lk->tail = 0;
+    if(shared){
+      lk->readers++;
+    } else {
+      lk->locked = 1;
+      lk->owner = w->p;
+      lk->pid = w->p->pid;
+    }
+    w->granted = 1;
+    // w->p can't leave waitsleep(), taking w with it,
+    // until we release lk->lk.
+    wakeproc(w->p, w);
+    if(!shared)
+      break;
+  }
 }
 
 void
 acquiresleep(struct sleeplock *lk)
 {
+  struct proc *p = myproc();
+  uint64 sleeps = 0, spins = 0, end;
+
   acquire(&lk->lk);
-  while (lk->locked) {
-    sleep(lk, &lk->lk);
+  end = r_time() + SLEEPSPIN;
+  while(lk->locked && lk->head == 0 && ownerrunning(lk) && r_time() < end){
+    release(&lk->lk);
+    while(__atomic_load_n(&lk->locked, __ATOMIC_RELAXED) &&
+          ownerrunning(lk) && r_time() < end)
+      spins++;
+    acquire(&lk->lk);
+  }
+
+  if(lk->locked || lk->readers > 0){
+    // grant() makes us the holder.
+    sleeps = waitsleep(lk, 0);
+  } else {
+    lk->locked = 1;
+    lk->owner = p;
+    lk->pid = p->pid;
   }
-  lk->locked = 1;
-  lk->pid = myproc()->pid;
+#ifdef LOCKSTAT
+  lk->tacquired = r_time();
+#endif
+  // a spell of spinning counts as one wait, like a sleep.
+  lockstat_acquire(lk->stat, sleeps + (spins > 0));
   release(&lk->lk);
 }
 
@@ -34,9 +149,40 @@ void
 releasesleep(struct sleeplock *lk)
 {
   acquire(&lk->lk);
+  lockstat_release(lk->stat, r_time() - lk->tacquired);
   lk->locked = 0;
+  lk->owner = 0;
   lk->pid = 0;
-  wakeup(lk);
+  // without letting go of lk->lk, so that nobody can slip
+  // in before the waiters get to run.
+  grant(lk);
+  release(&lk->lk);
+}
+
+// Acquire lk shared with other readers. Readers aren't recorded
+// in lk->pid, and have no hold time in lockstat.
+void
+acquiresleepshared(struct sleeplock *lk)
+{
+  uint64 sleeps = 0;
+
+  acquire(&lk->lk);
+  if(lk->locked || lk->head != 0)
+    sleeps = waitsleep(lk, 1);
+  else
+    lk->readers++;
+  lockstat_acquire(lk->stat, sleeps);
+  release(&lk->lk);
+}
+
+void
+releasesleepshared(struct sleeplock *lk)
+{
+  acquire(&lk->lk);
+  if(lk->readers < 1)
+    panic("releasesleepshared");
+  if(--lk->readers == 0)
+    grant(lk);
   release(&lk->lk);
 }
 
@@ -51,5 +197,18 @@ holdingsleep(struct sleeplock *lk)
   return r;
 }
 
+// Whether anyone holds lk shared; readers aren't recorded,
+// so not necessarily this process.
+int
+holdingsleepshared(struct sleeplock *lk)
+{
+  int r;
+
+  acquire(&lk->lk);
+  r = lk->readers > 0;
+  release(&lk->lk);
+  return r;
+}
+
 
 
@@ -1,10 +1,20 @@
 // Long-term locks for processes
 struct sleeplock {
   uint locked;       // Is the lock held?
+  int readers;       // Processes holding the lock shared
   struct spinlock lk; // spinlock protecting this sleep lock
+  struct proc *owner; // Process holding lock; waiters spin while it runs
+  struct sleepwaiter *head; // Processes waiting, first come first served
+  struct sleepwaiter *tail;
   
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+
+#ifdef LOCKSTAT
+  // For lockstat():
+  int stat;          // Record for locks of this name
+  uint64 tacquired;  // r_time() when acquired
+#endif
 };
 
@@ -5,6 +5,7 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "riscv.h"
+#include "timer.h"
 #include "proc.h"
 #include "defs.h"
 
@@ -12,8 +13,19 @@ void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
+#if defined(LOCK_MCS)
+  lk->tail = 0;
+  lk->node = 0;
+#elif defined(LOCK_TAS)
   lk->locked = 0;
+#else
+  lk->next = 0;
+  lk->owner = 0;
+#endif
   lk->cpu = 0;
+#ifdef LOCKSTAT
+  lk->stat = lockstat_register(name, 0);
+#endif
 }
 
 // Acquire the lock.
@@ -21,16 +33,46 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  uint64 spins = 0;
+
   push_off(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
+#if defined(LOCK_MCS)
+  struct cpu *c = mycpu();
+  struct mcsnode *n, *prev;
+
+  for(n = c->mcs; n < &c->mcs[NMCSNODE] && n->busy; n++)
+    ;
+  if(n == &c->mcs[NMCSNODE])
+    panic("acquire: too many locks");
+  n->busy = 1;
+  n->next = 0;
+  n->wait = 1;
+  // join the queue; if there was a holder, wait for it (or
+  // the waiter before us) to hand the lock over.
+  prev = __atomic_exchange_n(&lk->tail, n, __ATOMIC_ACQ_REL);
+  if(prev != 0){
+    __atomic_store_n(&prev->next, n, __ATOMIC_RELEASE);
+    while(__atomic_load_n(&n->wait, __ATOMIC_ACQUIRE))
+      spins++;
+  }
+  lk->node = n;
+#elif defined(LOCK_TAS)
   // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
   //   a5 = 1
   //   s1 = &lk->locked
   //   amoswap.w.aq a5, a5, (s1)
   while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+    spins++;
+#else
+  // take a ticket, with an atomic add (amoadd.w), and wait
+  // for it to be served; only loads spin on the lock.
+  uint ticket = __atomic_fetch_add(&lk->next, 1, __ATOMIC_RELAXED);
+  while(__atomic_load_n(&lk->owner, __ATOMIC_ACQUIRE) != ticket)
+    spins++;
+#endif
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,6 +82,10 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for holding() and debugging.
   lk->cpu = mycpu();
+#ifdef LOCKSTAT
+  lk->tacquired = r_time();
+#endif
+  lockstat_acquire(lk->stat, spins);
 }
 
 // Release the lock.
@@ -49,6 +95,7 @@ release(struct spinlock *lk)
   if(!holding(lk))
     panic("release");
 
+  lockstat_release(lk->stat, r_time() - lk->tacquired);
   lk->cpu = 0;
 
   // Tell the C compiler and the CPU to not move loads or stores
@@ -59,6 +106,25 @@ release(struct spinlock *lk)
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
+#if defined(LOCK_MCS)
+  struct mcsnode *n = lk->node, *next, *self = n;
+
+  // with no waiter, leave the lock free; a waiter that has
+  // swapped itself into tail but not yet linked itself to
+  // us makes the compare-and-swap fail, so wait for it.
+  if((next = __atomic_load_n(&n->next, __ATOMIC_ACQUIRE)) == 0){
+    if(__atomic_compare_exchange_n(&lk->tail, &self, 0, 0,
+                                   __ATOMIC_RELEASE, __ATOMIC_RELAXED)){
+      n->busy = 0;
+      pop_off();
+      return;
+    }
+    while((next = __atomic_load_n(&n->next, __ATOMIC_ACQUIRE)) == 0)
+      ;
+  }
+  __atomic_store_n(&next->wait, 0, __ATOMIC_RELEASE);
+  n->busy = 0;
+#elif defined(LOCK_TAS)
   // Release the lock, equivalent to lk->locked = 0.
   // This code doesn't use a C assignment, since the C standard
   // implies that an assignment might be implemented with
@@ -67,6 +133,10 @@ release(struct spinlock *lk)
   //   s1 = &lk->locked
   //   amoswap.w zero, zero, (s1)
   __sync_lock_release(&lk->locked);
+#else
+  // serve the next ticket. only the holder writes owner.
+  __atomic_store_n(&lk->owner, lk->owner + 1, __ATOMIC_RELEASE);
+#endif
 
   pop_off();
 }
@@ -76,9 +146,9 @@ release(struct spinlock *lk)
 int
 holding(struct spinlock *lk)
 {
-  int r;
-  r = (lk->locked && lk->cpu == mycpu());
-  return r;
+  // only the holder sets lk->cpu to itself, and it clears
+  // it before letting go.
+  return lk->cpu == mycpu();
 }
 
 // push_off/pop_off are like intr_off()/intr_on() except that they are matched:
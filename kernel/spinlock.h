@@ -1,9 +1,39 @@
-// Mutual exclusion lock.
+// Mutual exclusion lock. The kernel is built with one of three
+// implementations, chosen with make LOCK=...:
+//   TICKET  harts take a ticket and are served in order (default).
+//   MCS     harts queue on nodes of their own, and each spins on
+//           its own node rather than on the lock's cache line.
+//   TAS     harts race to swap 1 into the lock, in no order.
+
+// A waiter's place in an MCS lock's queue. Each cpu has a node
+// for every lock it may hold or wait for at once; see struct cpu.
+// A node fills a cache line, so that a waiter spins on a line
+// that only its predecessor writes.
+#define NMCSNODE 8
+struct mcsnode {
+  struct mcsnode *next;  // The waiter after this one
+  int wait;              // Spin while set; the previous holder clears it
+  int busy;              // In use by this cpu
+} __attribute__((aligned(CACHELINE)));
+
 struct spinlock {
+#if defined(LOCK_MCS)
+  struct mcsnode *tail;  // Last waiter, or holder; 0 if free
+  struct mcsnode *node;  // Holder's node
+#elif defined(LOCK_TAS)
   uint locked;       // Is the lock held?
+#else
+  uint next;         // Next ticket to hand out
+  uint owner;        // Ticket being served
+#endif
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
-};
 
+#ifdef LOCKSTAT
+  // For lockstat():
+  int stat;          // Record for locks of this name
+  uint64 tacquired;  // r_time() when acquired
+#endif
+};
@@ -6,10 +6,15 @@
 
 void main();
 void timerinit();
+void ipiinit();
+extern void machinevec();
 
 // entry.S needs one stack per CPU.
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 
+// a scratch area per CPU for machinevec, a cache line each.
+__attribute__ ((aligned (CACHELINE))) uint64 mscratch0[NCPU][CACHELINE/sizeof(uint64)];
+
 // entry.S jumps here in machine mode on stack0.
 void
 start()
@@ -40,6 +45,9 @@ start()
   // ask for clock interrupts.
   timerinit();
 
+  // take other harts' interrupts.
+  ipiinit();
+
   // keep each CPU's hartid in its tp register, for cpuid().
   int id = r_mhartid();
   w_tp(id);
@@ -62,5 +70,15 @@ timerinit()
   w_mcounteren(r_mcounteren() | 2);
   
   // ask for the very first timer interrupt.
-  w_stimecmp(r_time() + 1000000);
+  w_stimecmp(r_time() + TICKCYCLES);
+}
+
+// have machinevec in kernelvec.S pass the machine-mode software
+// interrupts that ipisend() raises on to supervisor mode.
+void
+ipiinit()
+{
+  w_mscratch((uint64)&mscratch0[r_mhartid()]);
+  w_mtvec((uint64)machinevec);
+  w_mie(r_mie() | MIE_MSIE);
 }
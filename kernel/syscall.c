@@ -3,6 +3,7 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "timer.h"
 #include "proc.h"
 #include "syscall.h"
 #include "defs.h"
@@ -12,7 +13,7 @@ int
 fetchaddr(uint64 addr, uint64 *ip)
 {
   struct proc *p = myproc();
-  if(addr >= p->sz || addr+sizeof(uint64) > p->sz) // both tests needed, in case of overflow
+  if(addr >= p->tg->sz || addr+sizeof(uint64) > p->tg->sz) // both tests needed, in case of overflow
     return -1;
   if(copyin(p->pagetable, (char *)ip, addr, sizeof(*ip)) != 0)
     return -1;
@@ -105,6 +106,31 @@ extern uint64 sys_trace(void);
 extern uint64 sys_kpgtbl(void);
 extern uint64 sys_sigalarm(void);
 extern uint64 sys_sigreturn(void);
+extern uint64 sys_setweight(void);
+extern uint64 sys_nanosleep(void);
+extern uint64 sys_setaffinity(void);
+extern uint64 sys_getaffinity(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_join(void);
+extern uint64 sys_futex_wait(void);
+extern uint64 sys_futex_wake(void);
+extern uint64 sys_schedstat(void);
+extern uint64 sys_loadavg(void);
+extern uint64 sys_setrt(void);
+extern uint64 sys_rtyield(void);
+extern uint64 sys_sigaction(void);
+extern uint64 sys_sigprocmask(void);
+extern uint64 sys_sigsend(void);
+extern uint64 sys_setitimer(void);
+extern uint64 sys_kprofctl(void);
+extern uint64 sys_kprofread(void);
+extern uint64 sys_uprof(void);
+extern uint64 sys_uprofread(void);
+extern uint64 sys_lockstat(void);
+extern uint64 sys_kstat(void);
+extern uint64 sys_uring_setup(void);
+extern uint64 sys_uring_enter(void);
+extern uint64 sys_traceread(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -134,38 +160,82 @@ static uint64 (*syscalls[])(void) = {
 [SYS_kpgtbl]      sys_kpgtbl,
 [SYS_sigalarm]    sys_sigalarm,
 [SYS_sigreturn]   sys_sigreturn,
+[SYS_setweight]   sys_setweight,
+[SYS_nanosleep]   sys_nanosleep,
+[SYS_setaffinity] sys_setaffinity,
+[SYS_getaffinity] sys_getaffinity,
+[SYS_clone]       sys_clone,
+[SYS_join]        sys_join,
+[SYS_futex_wait]  sys_futex_wait,
+[SYS_futex_wake]  sys_futex_wake,
+[SYS_schedstat]   sys_schedstat,
+[SYS_loadavg]     sys_loadavg,
+[SYS_setrt]       sys_setrt,
+[SYS_rtyield]     sys_rtyield,
+[SYS_sigaction]   sys_sigaction,
+[SYS_sigprocmask] sys_sigprocmask,
+[SYS_sigsend]     sys_sigsend,
+[SYS_setitimer]   sys_setitimer,
+[SYS_kprofctl]    sys_kprofctl,
+[SYS_kprofread]   sys_kprofread,
+[SYS_uprof]       sys_uprof,
+[SYS_uprofread]   sys_uprofread,
+[SYS_lockstat]    sys_lockstat,
+[SYS_kstat]       sys_kstat,
+[SYS_uring_setup] sys_uring_setup,
+[SYS_uring_enter] sys_uring_enter,
+[SYS_traceread]   sys_traceread,
 };
 
-// An array mapping syscall numbers from syscall.h
-// to the name of that system call.
-static char* syscalls_names[] = {
-[SYS_fork]    "fork",
-[SYS_exit]    "exit",
-[SYS_wait]    "wait",
-[SYS_pipe]    "pipe",
-[SYS_read]    "read",
-[SYS_kill]    "kill",
-[SYS_exec]    "exec",
-[SYS_fstat]   "fstat",
-[SYS_chdir]   "chdir",
-[SYS_dup]     "dup",
-[SYS_getpid]  "getpid",
-[SYS_sbrk]    "sbrk",
-[SYS_sleep]   "sleep",
-[SYS_uptime]  "uptime",
-[SYS_open]    "open",
-[SYS_write]   "write",
-[SYS_mknod]   "mknod",
-[SYS_unlink]  "unlink",
-[SYS_link]    "link",
-[SYS_mkdir]   "mkdir",
-[SYS_close]   "close",
-[SYS_trace]   "trace",
-[SYS_kpgtbl]     "kpgtbl",
-[SYS_sigalarm]   "sigalarm",
-[SYS_sigreturn]  "sigreturn",
+// The system calls a uring may run: those that need nothing
+// of the caller's trapframe but their arguments, and return.
+static char uringcalls[] = {
+[SYS_read]    1,
+[SYS_fstat]   1,
+[SYS_dup]     1,
+[SYS_open]    1,
+[SYS_write]   1,
+[SYS_mknod]   1,
+[SYS_unlink]  1,
+[SYS_link]    1,
+[SYS_mkdir]   1,
+[SYS_close]   1,
 };
 
+// Run system call num with the given arguments for a uring,
+// as if the current thread had made it, and return its result.
+uint64
+syscallrun(int num, uint64 *args)
+{
+  struct trapframe *tf = myproc()->trapframe;
+  uint64 a0 = tf->a0, a1 = tf->a1, a2 = tf->a2, retval;
+
+  if(num <= 0 || num >= NELEM(uringcalls) || !uringcalls[num])
+    return -1;
+  tf->a0 = args[0];
+  tf->a1 = args[1];
+  tf->a2 = args[2];
+  retval = syscalls[num]();
+  tf->a0 = a0;
+  tf->a1 = a1;
+  tf->a2 = a2;
+  return retval;
+}
+
+// Run system call num for p, whose trace mask selects it,
+// and record it in this hart's trace ring.
+static uint64
+syscalltraced(struct proc *p, int num)
+{
+  struct trapframe *tf = p->trapframe;
+  uint64 args[6] = { tf->a0, tf->a1, tf->a2, tf->a3, tf->a4, tf->a5 };
+  uint64 start = r_time();
+  uint64 retval = syscalls[num]();
+
+  tracerecord(p->pid, num, args, start, retval);
+  return retval;
+}
+
 void
 syscall(void)
 {
@@ -176,22 +246,12 @@ syscall(void)
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
     // Use num to lookup the system call function for num, call it,
     // and store its return value in p->trapframe->a0
-    uint64 retval = syscalls[num]();
-
-    // trace output
-    if (((p->tracemask)>>num)&1) {
-      printf("trace: %d: %s: \n-----: args: 0: %lu 1: %lu 2: %lu 3: %lu 4: %lu 5: %lu\n-----: return: %lu\n",
-             p->pid,
-             syscalls_names[num],
-             p->trapframe->a0,
-             p->trapframe->a1,
-             p->trapframe->a2,
-             p->trapframe->a3,
-             p->trapframe->a4,
-             p->trapframe->a5,
-             retval);
-    }
+    uint64 retval;
 
+    if((p->tracemask >> num) & 1)
+      retval = syscalltraced(p, num);
+    else
+      retval = syscalls[num]();
     p->trapframe->a0 = retval;
   } else {
     printf("%d %s: unknown sys call %d\n",
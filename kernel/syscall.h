@@ -23,4 +23,29 @@
 #define SYS_trace  22
 #define SYS_kpgtbl     23
 #define SYS_sigalarm   24
-#define SYS_sigreturn  25
\ No newline at end of file
+#define SYS_sigreturn  25
+#define SYS_setweight  26
+#define SYS_nanosleep  27
+#define SYS_setaffinity 28
+#define SYS_getaffinity 29
+#define SYS_clone      30
+#define SYS_join       31
+#define SYS_futex_wait 32
+#define SYS_futex_wake 33
+#define SYS_schedstat  34
+#define SYS_loadavg    35
+#define SYS_setrt      36
+#define SYS_rtyield    37
+#define SYS_sigaction  38
+#define SYS_sigprocmask 39
+#define SYS_sigsend    40
+#define SYS_setitimer  41
+#define SYS_kprofctl   42
+#define SYS_kprofread  43
+#define SYS_uprof      44
+#define SYS_uprofread  45
+#define SYS_lockstat   46
+#define SYS_kstat      47
+#define SYS_uring_setup 48
+#define SYS_uring_enter 49
+#define SYS_traceread  50
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include "param.h"
 #include "stat.h"
 #include "spinlock.h"
+#include "timer.h"
 #include "proc.h"
 #include "fs.h"
 #include "sleeplock.h"
@@ -25,7 +26,7 @@ argfd(int n, int *pfd, struct file **pf)
   struct file *f;
 
   argint(n, &fd);
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if(fd < 0 || fd >= NOFILE || (f=myproc()->tg->ofile[fd]) == 0)
     return -1;
   if(pfd)
     *pfd = fd;
@@ -40,17 +41,38 @@ static int
 fdalloc(struct file *f)
 {
   int fd;
-  struct proc *p = myproc();
+  struct tgroup *tg = myproc()->tg;
 
+  acquire(&tg->lock);
   for(fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd] == 0){
-      p->ofile[fd] = f;
+    if(tg->ofile[fd] == 0){
+      tg->ofile[fd] = f;
+      release(&tg->lock);
       return fd;
     }
   }
+  release(&tg->lock);
   return -1;
 }
 
+// Free file descriptor fd, if it still holds f: another thread
+// may have closed it already, and even reused it.
+// Returns 0 if the caller now holds fd's reference to f.
+static int
+fdfree(int fd, struct file *f)
+{
+  struct tgroup *tg = myproc()->tg;
+
+  acquire(&tg->lock);
+  if(tg->ofile[fd] != f){
+    release(&tg->lock);
+    return -1;
+  }
+  tg->ofile[fd] = 0;
+  release(&tg->lock);
+  return 0;
+}
+
 uint64
 sys_dup(void)
 {
@@ -102,7 +124,9 @@ sys_close(void)
 
   if(argfd(0, &fd, &f) < 0)
     return -1;
-  myproc()->ofile[fd] = 0;
+  // another thread may be closing fd too.
+  if(fdfree(fd, f) < 0)
+    return -1;
   fileclose(f);
   return 0;
 }
@@ -410,24 +434,27 @@ uint64
 sys_chdir(void)
 {
   char path[MAXPATH];
-  struct inode *ip;
-  struct proc *p = myproc();
+  struct inode *ip, *old;
+  struct tgroup *tg = myproc()->tg;
   
   begin_op();
   if(argstr(0, path, MAXPATH) < 0 || (ip = namei(path)) == 0){
     end_op();
     return -1;
   }
-  ilock(ip);
+  ilockshared(ip);
   if(ip->type != T_DIR){
     iunlockput(ip);
     end_op();
     return -1;
   }
   iunlock(ip);
-  iput(p->cwd);
+  acquire(&tg->lock);
+  old = tg->cwd;
+  tg->cwd = ip;
+  release(&tg->lock);
+  iput(old);
   end_op();
-  p->cwd = ip;
   return 0;
 }
 
@@ -486,19 +513,20 @@ sys_pipe(void)
   if(pipealloc(&rf, &wf) < 0)
     return -1;
   fd0 = -1;
+  // another thread may close fd0 or fd1 as soon as they
+  // exist; if it has, it has closed that end as well.
   if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
-    if(fd0 >= 0)
-      p->ofile[fd0] = 0;
-    fileclose(rf);
+    if(fd0 < 0 || fdfree(fd0, rf) == 0)
+      fileclose(rf);
     fileclose(wf);
     return -1;
   }
   if(copyout(p->pagetable, fdarray, (char*)&fd0, sizeof(fd0)) < 0 ||
      copyout(p->pagetable, fdarray+sizeof(fd0), (char *)&fd1, sizeof(fd1)) < 0){
-    p->ofile[fd0] = 0;
-    p->ofile[fd1] = 0;
-    fileclose(rf);
-    fileclose(wf);
+    if(fdfree(fd0, rf) == 0)
+      fileclose(rf);
+    if(fdfree(fd1, wf) == 0)
+      fileclose(wf);
     return -1;
   }
   return 0;
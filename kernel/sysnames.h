@@ -0,0 +1,54 @@
+// The names of the system calls, by SYS_ number; include
+// syscall.h first. For strace, which prints traced calls.
+static char *syscalls_names[] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_trace]   "trace",
+[SYS_kpgtbl]     "kpgtbl",
+[SYS_sigalarm]   "sigalarm",
+[SYS_sigreturn]  "sigreturn",
+[SYS_setweight]  "setweight",
+[SYS_nanosleep]  "nanosleep",
+[SYS_setaffinity] "setaffinity",
+[SYS_getaffinity] "getaffinity",
+[SYS_clone]      "clone",
+[SYS_join]       "join",
+[SYS_futex_wait] "futex_wait",
+[SYS_futex_wake] "futex_wake",
+[SYS_schedstat]  "schedstat",
+[SYS_loadavg]    "loadavg",
+[SYS_setrt]      "setrt",
+[SYS_rtyield]    "rtyield",
+[SYS_sigaction]  "sigaction",
+[SYS_sigprocmask] "sigprocmask",
+[SYS_sigsend]    "sigsend",
+[SYS_setitimer]  "setitimer",
+[SYS_kprofctl]   "kprofctl",
+[SYS_kprofread]  "kprofread",
+[SYS_uprof]      "uprof",
+[SYS_uprofread]  "uprofread",
+[SYS_lockstat]   "lockstat",
+[SYS_kstat]      "kstat",
+[SYS_uring_setup] "uring_setup",
+[SYS_uring_enter] "uring_enter",
+[SYS_traceread]  "traceread",
+};
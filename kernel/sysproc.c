@@ -4,6 +4,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
+#include "timer.h"
 #include "proc.h"
 
 uint64
@@ -37,8 +38,7 @@ sys_sbrk(void) {
   int n;
 
   argint(0, &n);
-  addr = myproc()->sz;
-  if (growproc(n) < 0)
+  if (growproc(n, &addr) < 0)
     return -1;
   return addr;
 }
@@ -46,21 +46,18 @@ sys_sbrk(void) {
 uint64
 sys_sleep(void) {
   int n;
-  uint ticks0;
   argint(0, &n);
   if (n < 0)
     n = 0;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while (ticks - ticks0 < n) {
-    if (killed(myproc())) {
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  return sleepuntil(r_time() + (uint64)n * TICKCYCLES);
+}
+
+// sleep for the given number of nanoseconds.
+uint64
+sys_nanosleep(void) {
+  uint64 ns;
+  argaddr(0, &ns);
+  return sleepuntil(r_time() + ns / (1000000000 / TIMEBASE));
 }
 
 uint64
@@ -71,29 +68,108 @@ sys_kill(void) {
   return kill(pid);
 }
 
-// return how many clock tick interrupts have occurred
+// return how many clock ticks have passed
 // since start.
 uint64
 sys_uptime(void) {
-  uint xticks;
-
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
-  return xticks;
+  return uptime();
 }
 
 uint64
-sys_trace(void) {
-  int n;
-  argint(0, &n);
-  trace(n);
+sys_kpgtbl(void) {
+  pagetable_t pt = myproc() -> pagetable;
+  vmprint(pt);
   return 0;
 }
 
 uint64
-sys_kpgtbl(void) {
-  pagetable_t pt = myproc() -> pagetable;
-  vmprint(pt);
+sys_setweight(void) {
+  int pid, weight;
+
+  argint(0, &pid);
+  argint(1, &weight);
+  return setweight(pid, weight);
+}
+
+uint64
+sys_setaffinity(void) {
+  int pid, mask;
+
+  argint(0, &pid);
+  argint(1, &mask);
+  return setaffinity(pid, mask);
+}
+
+uint64
+sys_getaffinity(void) {
+  int pid;
+
+  argint(0, &pid);
+  return getaffinity(pid);
+}
+
+uint64
+sys_clone(void) {
+  uint64 fn, arg, stack;
+
+  argaddr(0, &fn);
+  argaddr(1, &arg);
+  argaddr(2, &stack);
+  return clone(fn, arg, stack);
+}
+
+uint64
+sys_join(void) {
+  int pid;
+  uint64 p;
+
+  argint(0, &pid);
+  argaddr(1, &p);
+  return join(pid, p);
+}
+
+uint64
+sys_schedstat(void) {
+  int pid, n;
+  uint64 st;
+
+  argint(0, &pid);
+  argaddr(1, &st);
+  argint(2, &n);
+  return schedstat(pid, st, n);
+}
+
+uint64
+sys_loadavg(void) {
+  uint64 addr;
+  int avg[3];
+
+  argaddr(0, &addr);
+  getloadavg(avg);
+  if(copyout(myproc()->pagetable, addr, (char*)avg, sizeof(avg)) < 0)
+    return -1;
   return 0;
 }
+
+// runtime, deadline and period are in nanoseconds.
+uint64
+sys_setrt(void) {
+  int pid, i;
+  uint64 ns, cycles[3];  // runtime, deadline, period
+
+  argint(0, &pid);
+  for(i = 0; i < 3; i++){
+    argaddr(i + 1, &ns);
+    cycles[i] = ns / (1000000000 / TIMEBASE);
+    // less than a cycle must not read as 0, which would
+    // quietly take pid out of the real-time class.
+    if(ns != 0 && cycles[i] == 0)
+      return -1;
+  }
+  return setrt(pid, cycles[0], cycles[1], cycles[2]);
+}
+
+uint64
+sys_rtyield(void) {
+  return rtyield();
+}
@@ -0,0 +1,224 @@
+// Per-CPU timer queues.
+//
+// Each hart keeps a binary min-heap of pending timers, ordered
+// by r_time() deadline. clockarm() in trap.c programs the hart's
+// stimecmp for the earliest of its heap top and the end of the
+// running process's quantum, so a timer fires in the interrupt
+// that follows its deadline, on the hart that added it.
+//
+// Sleepers use their own timer, so a sleeper is woken when and
+// only when its own deadline passes.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "proc.h"
+#include "defs.h"
+
+// the heap is kept in pages allocated as it first grows.
+#define TPERPG   (PGSIZE / sizeof(struct timer*))
+#define NTIMERPG ((NTIMER + TPERPG - 1) / TPERPG)
+#define HEAP(q, i) ((q)->heap[(i) / TPERPG][(i) % TPERPG])
+
+// a queue per cpu, each on cache lines of its own.
+struct tqueue {
+  struct spinlock lock;
+  int n;                        // number of pending timers
+  int max;                      // number that fit in the heap's pages
+  uint64 next;                  // HEAP(q, 0)->deadline, or NEVER
+  struct timer **heap[NTIMERPG];
+} __attribute__((aligned(CACHELINE)));
+
+static struct tqueue tqueues[NCPU];
+
+void
+timerqinit(void)
+{
+  for(int i = 0; i < NCPU; i++){
+    initlock(&tqueues[i].lock, "timerq");
+    tqueues[i].next = NEVER;
+  }
+}
+
+static void
+heapset(struct tqueue *q, int i, struct timer *t)
+{
+  HEAP(q, i) = t;
+  t->idx = i;
+}
+
+// Move the timer at i towards the root while it is
+// earlier than its parent.
+static void
+siftup(struct tqueue *q, int i)
+{
+  struct timer *t = HEAP(q, i);
+
+  while(i > 0 && t->deadline < HEAP(q, (i-1)/2)->deadline){
+    heapset(q, i, HEAP(q, (i-1)/2));
+    i = (i-1)/2;
+  }
+  heapset(q, i, t);
+}
+
+// Move the timer at i towards the leaves while it is
+// later than one of its children.
+static void
+siftdown(struct tqueue *q, int i)
+{
+  struct timer *t = HEAP(q, i);
+  int c;
+
+  while((c = 2*i+1) < q->n){
+    if(c+1 < q->n && HEAP(q, c+1)->deadline < HEAP(q, c)->deadline)
+      c++;
+    if(t->deadline <= HEAP(q, c)->deadline)
+      break;
+    heapset(q, i, HEAP(q, c));
+    i = c;
+  }
+  heapset(q, i, t);
+}
+
+// Caller must hold q->lock.
+static int
+heapinsert(struct tqueue *q, struct timer *t)
+{
+  if(q->n == q->max){
+    if(q->max == NTIMERPG * TPERPG ||
+       (q->heap[q->max / TPERPG] = (struct timer**)kalloc()) == 0)
+      return -1;
+    q->max += TPERPG;
+  }
+  t->q = q;
+  t->fired = 0;
+  heapset(q, q->n++, t);
+  siftup(q, t->idx);
+  q->next = HEAP(q, 0)->deadline;
+  return 0;
+}
+
+// Caller must hold q->lock.
+static void
+heapremove(struct tqueue *q, struct timer *t)
+{
+  int i = t->idx;
+
+  if(i < 0)
+    return;
+  t->idx = -1;
+  if(i != --q->n){
+    heapset(q, i, HEAP(q, q->n));
+    siftdown(q, i);
+    siftup(q, i);
+  }
+  q->next = q->n > 0 ? HEAP(q, 0)->deadline : NEVER;
+}
+
+// Queue t on this hart, to fire at t->deadline.
+// Returns -1 if this hart has too many pending timers.
+int
+timer_add(struct timer *t)
+{
+  struct tqueue *q;
+  int r;
+
+  push_off();
+  q = &tqueues[cpuid()];
+  acquire(&q->lock);
+  r = heapinsert(q, t);
+  release(&q->lock);
+  // the new timer may be earlier than what stimecmp holds.
+  if(r == 0 && t->idx == 0)
+    clockarm();
+  pop_off();
+  return r;
+}
+
+// Stop t if it has not fired yet.
+void
+timer_cancel(struct timer *t)
+{
+  struct tqueue *q = t->q;
+
+  if(q == 0)
+    return;
+  acquire(&q->lock);
+  heapremove(q, t);
+  release(&q->lock);
+}
+
+// The earliest pending deadline on this hart.
+// Interrupts must be disabled.
+uint64
+timer_next(void)
+{
+  // unlocked read; a hart always calls clockarm()
+  // after adding a timer at the head of its own queue.
+  return tqueues[cpuid()].next;
+}
+
+// Fire this hart's expired timers, from the timer interrupt.
+// Returns the number that fired.
+int
+timerintr(void)
+{
+  struct tqueue *q = &tqueues[cpuid()];
+  struct timer *t;
+  uint64 next;
+  int n = 0;
+
+  acquire(&q->lock);
+  while(q->n > 0 && (t = HEAP(q, 0))->deadline <= r_time()){
+    heapremove(q, t);
+    t->fired = 1;
+    if((next = t->fn(t)) != 0){
+      t->deadline = next;
+      heapinsert(q, t);  // can't fail: t's slot was just freed
+    }
+    n++;
+  }
+  release(&q->lock);
+  return n;
+}
+
+static uint64
+wakesleeper(struct timer *t)
+{
+  wakeproc(t->arg, t);
+  return 0;
+}
+
+// Sleep until r_time() reaches deadline, on a timer of our own.
+// Returns -1 if killed or signalled first, or if no timer
+// is available.
+int
+sleepuntil(uint64 deadline)
+{
+  struct proc *p = myproc();
+  struct timer t;
+  int r = 0;
+
+  t.deadline = deadline;
+  t.fn = wakesleeper;
+  t.arg = p;
+  if(timer_add(&t) < 0)
+    return -1;
+
+  // t.q is the queue of the hart we added t on; we may
+  // wake up on another hart, but t stays where it is.
+  acquire(&t.q->lock);
+  while(!t.fired){
+    if(interrupted(p)){
+      heapremove(t.q, &t);
+      r = -1;
+      break;
+    }
+    sleep(&t, &t.q->lock);
+  }
+  release(&t.q->lock);
+  return r;
+}
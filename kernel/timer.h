@@ -0,0 +1,15 @@
+// A timer fires in the timer interrupt of the hart whose
+// queue it was added to, once r_time() reaches its deadline.
+struct timer {
+  uint64 deadline;              // r_time() at which to fire
+  uint64 (*fn)(struct timer*);  // called on expiry, with the queue locked;
+                                // returns the next deadline, or 0 if done
+  void *arg;                    // for fn
+  int fired;                    // has it expired (and not been re-added)?
+
+  // owned by timer.c:
+  struct tqueue *q;             // queue it was added to
+  int idx;                      // position in q's heap, or -1
+};
+
+#define NEVER (~0UL)            // a deadline that never arrives
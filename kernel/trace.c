@@ -0,0 +1,129 @@
+// System call tracing.
+//
+// syscall() records each call a process's trace() mask selects
+// as a binary event in its hart's ring, rather than printing it,
+// which would take long enough to change what is being traced
+// and would make every hart wait for the console. Like kprof's
+// rings, each ring has one producer, its own hart with
+// interrupts off, which takes no lock; traceread() copies events
+// out. Events that find the ring full are dropped and counted.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "proc.h"
+#include "trace.h"
+#include "defs.h"
+
+#define NTRACEEVENT 256   // per cpu; a power of two
+
+// the hart's and the reader's indexes are on separate cache
+// lines, as are the rings of different harts.
+struct tracering {
+  uint head;              // next slot to fill; written by the hart
+  uint dropped;
+  uint tail __attribute__((aligned(CACHELINE))); // next slot to read; written by traceread()
+  struct traceevent buf[NTRACEEVENT];
+} __attribute__((aligned(CACHELINE)));
+
+static struct tracering rings[NCPU];
+static struct spinlock tracelock;  // serializes traceread()s
+
+void
+traceinit(void)
+{
+  initlock(&tracelock, "trace");
+}
+
+// Record system call num, made by pid with arguments args at
+// r_time() start, which returned retval.
+void
+tracerecord(int pid, int num, uint64 *args, uint64 start, uint64 retval)
+{
+  struct tracering *r;
+  struct traceevent *e;
+  int cpu;
+
+  push_off();
+  cpu = cpuid();
+  r = &rings[cpu];
+  if(r->head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >= NTRACEEVENT){
+    r->dropped++;
+    pop_off();
+    return;
+  }
+  e = &r->buf[r->head % NTRACEEVENT];
+  e->time = start;
+  e->duration = r_time() - start;
+  memmove(e->args, args, sizeof(e->args));
+  e->retval = retval;
+  e->pid = pid;
+  e->cpu = cpu;
+  e->num = num;
+  __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+  pop_off();
+}
+
+// Trace the system calls in mask, a bit per SYS_ number, that
+// this process and the children it forks from now on make.
+// Returns the number of events dropped since the last call.
+int
+trace(uint64 mask)
+{
+  int dropped = 0;
+
+  myproc()->tracemask = mask;
+  for(int i = 0; i < NCPU; i++)
+    dropped += __atomic_exchange_n(&rings[i].dropped, 0, __ATOMIC_RELAXED);
+  return dropped;
+}
+
+// Copy up to n events from the harts' rings to the user
+// array at addr, and return the number copied.
+int
+traceread(uint64 addr, int n)
+{
+  struct proc *p = myproc();
+  struct traceevent e;
+  struct tracering *r;
+  int i, got = 0;
+
+  acquire(&tracelock);
+  for(i = 0; i < NCPU && got < n; i++){
+    r = &rings[i];
+    while(got < n && r->tail != __atomic_load_n(&r->head, __ATOMIC_ACQUIRE)){
+      e = r->buf[r->tail % NTRACEEVENT];
+      __atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+      if(copyout(p->pagetable, addr + got*sizeof(e), (char*)&e, sizeof(e)) < 0){
+        release(&tracelock);
+        return -1;
+      }
+      got++;
+    }
+  }
+  release(&tracelock);
+  return got;
+}
+
+uint64
+sys_trace(void)
+{
+  uint64 mask;
+
+  argaddr(0, &mask);
+  return trace(mask);
+}
+
+uint64
+sys_traceread(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return traceread(addr, n);
+}
@@ -0,0 +1,11 @@
+// A traced system call, from traceread().
+// Times are in r_time() cycles, TIMEBASE to the second.
+struct traceevent {
+  uint64 time;                // r_time() when the call was made
+  uint64 duration;            // until it returned
+  uint64 args[6];             // a0-a5, as the call found them
+  uint64 retval;
+  int pid;
+  short cpu;                  // cpu the call returned on
+  short num;                  // SYS_*
+};
@@ -3,11 +3,16 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "rwlock.h"
+#include "timer.h"
 #include "proc.h"
 #include "defs.h"
 
-struct spinlock tickslock;
-uint ticks;
+struct seqlock tickslock;
+uint ticks;               // TICKCYCLES periods of r_time() since boot
+uint64 tickbase;          // r_time() at boot
+
+static int kssyscall, ksfault;  // kstat counters
 
 extern char trampoline[], uservec[], userret[];
 
@@ -19,7 +24,10 @@ extern int devintr();
 void
 trapinit(void)
 {
-  initlock(&tickslock, "time");
+  initseqlock(&tickslock, "time");
+  kssyscall = kstat_register("syscall");
+  ksfault = kstat_register("pagefault");
+  tickbase = r_time();
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -27,6 +35,8 @@ void
 trapinithart(void)
 {
   w_stvec((uint64)kernelvec);
+  // let user code read the clock, for uuptime() in ulib.c.
+  w_scounteren(r_scounteren() | SCOUNTEREN_TM);
 }
 
 //
@@ -47,9 +57,18 @@ usertrap(void)
   w_stvec((uint64)kernelvec);
 
   struct proc *p = myproc();
+
+  // charge the time since usertrapret() to user time.
+  uint64 now = r_time();
+  p->utime += now - p->tstamp;
+  p->tstamp = now;
   
   // save user program counter.
   p->trapframe->epc = r_sepc();
+
+  // take a uprof sample that came due, whatever the trap.
+  if(p->uprof)
+    uprofsample(p, p->trapframe->epc);
   
   if(scause == 8){
     // system call
@@ -65,36 +84,54 @@ usertrap(void)
     // so enable only now that we're done with those registers.
     intr_on();
 
+    kstat_add(kssyscall, 1);
     syscall();
   }
   // scause 15 means page fault while write
   else if (scause == 15) {
     uint64 va = PGROUNDDOWN(r_stval());
+    kstat_add(ksfault, 1);
+    // other threads may be faulting on the same page.
+    acquire(&p->tg->lock);
     pte_t * pte = walk(p->pagetable, va, 0);
     uint64 pa = PTE2PA(*pte);
     uint flags = PTE_FLAGS(*pte);
+    uint64 old = 0;
     // this tells that it is a shared page which
     // originally had write permissions
     if (flags & PTE_COW) {
       if (krefcnt((void *)pa) > 1) {
         uint64* mem = kalloc();
-        if (mem < 0) {
-          kfree(mem);
+        if (mem == 0) {
+          release(&p->tg->lock);
           goto err;
         }
-        krefcntadd((void *)pa, -1);
         memmove(mem, (char*)pa, PGSIZE);
         *pte = (PA2PTE(mem) | flags | PTE_W | PTE_V) & ~PTE_COW;
+        old = pa;
       } else {
         // this is the only process referring that page
         // so remove the COW bit and set the W bit
         *pte = (*pte & ~PTE_COW) | PTE_W;
       }
-    } else {
+    } else if ((flags & PTE_W) == 0) {
+      release(&p->tg->lock);
       goto err;
     }
+    // else another thread got here first.
+    release(&p->tg->lock);
+    // the other threads' harts may still read the old page
+    // through their TLBs; once we let go of it, another
+    // process may write it in place. so drop our reference
+    // only after they have flushed.
+    if(old){
+      if(p->tg->ref > 1)
+        tlbshootdown(p->tg);
+      krefcntadd((void *)old, -1);
+    }
   } else if((which_dev = devintr()) != 0){
-    // ok
+    if(mycpu()->profdue)
+      profsample(p->trapframe->epc, 0);
   } else {
 err:
     printf("usertrap(): unexpected scause 0x%lx pid=%d\n", scause, p->pid);
@@ -106,23 +143,11 @@ err:
     exit(-1);
 
   // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2) {
-    if (
-        // sigalarm has been set
-        (p->sigalarm_period != 0) &&
-        // increment tick counter and check if it matches the period set
-        (++(p->sigalarm_tick_counter) == p->sigalarm_period) &&
-        // the handler must not already be running
-        p->sigalarm_is_handler_active == 0
-        ) {
-        p->sigalarm_is_handler_active = 1;
-        // save trapframe to return later when sigreturn is called
-        *(p->sigalarm_trapframe) = *(p->trapframe);
-        // set pc to handler, so when usertrapret() returns,
-        // the handler is called
-        p->trapframe->epc = (uint64) p->sigalarm_handler;
-    } else yield();
-  }
+  if(which_dev == 2 && !rtthrottle())
+    yield();
+
+  // enter a signal handler, if there is a signal to take.
+  sigdeliver();
 
   usertrapret();
 }
@@ -140,6 +165,15 @@ usertrapret(void)
   // we're back in user space, where usertrap() is correct.
   intr_off();
 
+  // charge the time in the kernel to system time.
+  uint64 now = r_time();
+  p->stime += now - p->tstamp;
+  p->tstamp = now;
+
+  handoffcancel();
+  usyscallupdate(p);
+  uprofarm(p);
+
   // send syscalls, interrupts, and exceptions to uservec in trampoline.S
   uint64 trampoline_uservec = TRAMPOLINE + (uservec - trampoline);
   w_stvec(trampoline_uservec);
@@ -167,10 +201,10 @@ usertrapret(void)
   uint64 satp = MAKE_SATP(p->pagetable);
 
   // jump to userret in trampoline.S at the top of memory, which 
-  // switches to the user page table, restores user registers,
-  // and switches to user mode with sret.
+  // switches to the user page table, restores user registers
+  // from this thread's trapframe, and switches to user mode with sret.
   uint64 trampoline_userret = TRAMPOLINE + (userret - trampoline);
-  ((void (*)(uint64))trampoline_userret)(satp);
+  ((void (*)(uint64, uint64))trampoline_userret)(satp, TRAPFRAMEN(p->tfslot));
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -194,6 +228,11 @@ kerneltrap()
     panic("kerneltrap");
   }
 
+  // kernelvec leaves s0 alone, so the frame pointer that this
+  // function saved is that of the interrupted code.
+  if(mycpu()->profdue)
+    profsample(sepc, *(uint64*)(r_fp() - 16));
+
   // give up the CPU if this is a timer interrupt.
   if(which_dev == 2 && myproc() != 0)
     yield();
@@ -204,26 +243,100 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
-void
+// any hart's timer interrupt advances ticks and fires
+// the hart's expired timers.
+// returns 1 if the running process should give up the cpu:
+// its quantum has expired, or a timer woke a sleeper.
+int
 clockintr()
 {
-  if(cpuid() == 0){
-    acquire(&tickslock);
-    ticks++;
-    wakeup(&ticks);
-    release(&tickslock);
+  struct cpu *c = mycpu();
+  uint64 now = r_time();
+  int expired = 0;
+
+  // most of a tick's interrupts find ticks already current,
+  // and needn't keep readers of loadavg waiting.
+  if(uptime() != ticks){
+    writeseqlock(&tickslock);
+    tickupdate();
+    writesequnlock(&tickslock);
+  }
+
+  if(timerintr() > 0)
+    expired = 1;
+
+  if(profinterval && now >= c->profnext){
+    // usertrap() or kerneltrap() takes the sample.
+    c->profnext = now + profinterval;
+    c->profdue = 1;
+  }
+
+  if(c->proc != 0 && now >= c->quantum_end){
+    expired = 1;
+    // in case the process keeps the cpu, e.g. to run a
+    // sigalarm handler, don't interrupt it again at once.
+    c->quantum_end = now + QUANTUM;
   }
 
   // ask for the next timer interrupt. this also clears
-  // the interrupt request. 1000000 is about a tenth
-  // of a second.
-  w_stimecmp(r_time() + 1000000);
+  // the interrupt request.
+  clockarm();
+  return expired;
+}
+
+// Program this hart's stimecmp for its next event: the end of
+// the running process's quantum or, on an idle hart, the next
+// periodic tick; or the hart's earliest timer (see timer.c) if
+// that is sooner. In a TICKLESS kernel idle harts have no
+// periodic tick and sleep in wfi until a timer, a device
+// interrupt, or an IPI from kick() brings them work. uprof's
+// deadline is left to usertrapret(); see uprofarm().
+// Interrupts must be disabled.
+void
+clockarm(void)
+{
+  struct cpu *c = mycpu();
+  uint64 next;
+
+  if(c->proc != 0)
+    next = c->quantum_end;
+  else
+#ifdef TICKLESS
+    next = NEVER;
+#else
+    next = r_time() + TICKCYCLES;
+#endif
+  if(timer_next() < next)
+    next = timer_next();
+  if(profinterval && c->profnext < next)
+    next = c->profnext;
+  w_stimecmp(next);
+}
+
+// Recompute ticks from r_time(), rather than trusting that
+// some hart took an interrupt every tick.
+// Caller must hold tickslock for writing.
+uint
+tickupdate(void)
+{
+  ticks = uptime();
+  loadupdate(ticks);
+  return ticks;
+}
+
+// Ticks since boot, straight from the clock, which every
+// hart can read without a lock.
+uint
+uptime(void)
+{
+  return (r_time() - tickbase) / TICKCYCLES;
 }
 
 // check if it's an external interrupt or software interrupt,
 // and handle it.
-// returns 2 if timer interrupt,
-// 1 if other device,
+// returns 2 if timer interrupt that ended the current quantum,
+// or a software interrupt that preempts the current process,
+// 1 if other device or timer,
 // 0 if not recognized.
 int
 devintr()
@@ -253,8 +366,10 @@ devintr()
     return 1;
   } else if(scause == 0x8000000000000005L){
     // timer interrupt.
-    clockintr();
-    return 2;
+    return clockintr() ? 2 : 1;
+  } else if(scause == 0x8000000000000001L){
+    // software interrupt from another hart; see ipi.c.
+    return ipiintr() ? 2 : 1;
   } else {
     return 0;
   }
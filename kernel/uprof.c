@@ -0,0 +1,176 @@
+// User PC-sampling profiler, in the manner of profil().
+//
+// uprof() gives the calling process a histogram of its user pcs
+// in kernel memory. Samples are taken on user cpu time:
+// usertrapret() asks for a timer interrupt when the next one could
+// be due, and usertrap() adds the interrupted pc to its bucket once
+// p->utime has reached it, whatever the trap. Since the histogram isn't in user memory it
+// survives exec(), so a profiler can turn it on in a child, exec
+// the program, and read the counts with uprofread() once the
+// child has exited, before wait() frees them.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "proc.h"
+#include "defs.h"
+
+#define UPROFPAGES (NUPROF * sizeof(uint) / PGSIZE)
+
+struct uprof {
+  uint64 interval;        // user time between samples, in r_time() cycles
+  uint64 next;            // p->utime at which the next sample is due
+  int shift;              // bucket i counts pcs in [i<<shift, (i+1)<<shift)
+  uint *pg[UPROFPAGES];   // the buckets, PGSIZE/sizeof(uint) per page
+};
+
+// Free p's histogram. Called by p itself, or by freeproc() once
+// p can no longer run.
+void
+uprofree(struct proc *p)
+{
+  struct uprof *u = p->uprof;
+
+  if(u == 0)
+    return;
+  p->uprof = 0;
+  for(int i = 0; i < UPROFPAGES; i++)
+    if(u->pg[i])
+      kfree(u->pg[i]);
+  kfree(u);
+}
+
+// Ask for a timer interrupt when p's next sample is due, if
+// that is sooner than the one already asked for. Called by
+// usertrapret() with interrupts off, since only user time brings
+// a sample due: a deadline armed for a stay in the kernel would
+// come and go without one, and clockarm() would arm it again.
+void
+uprofarm(struct proc *p)
+{
+  struct uprof *u = p->uprof;
+  uint64 next;
+
+  if(u == 0)
+    return;
+  next = r_time() + (u->next > p->utime ? u->next - p->utime : 0);
+  if(next < r_stimecmp())
+    w_stimecmp(next);
+}
+
+// Count pc, if a sample is due. Called by usertrap() on every
+// trap, with p->utime brought up to date.
+void
+uprofsample(struct proc *p, uint64 pc)
+{
+  struct uprof *u = p->uprof;
+  uint64 i;
+
+  if(u == 0 || p->utime < u->next)
+    return;
+  // don't make up for samples missed in a long stay in
+  // the kernel; they would all land on one pc.
+  u->next = p->utime + u->interval;
+  i = pc >> u->shift;
+  if(i < NUPROF)
+    u->pg[i / (PGSIZE/sizeof(uint))][i % (PGSIZE/sizeof(uint))]++;
+}
+
+// Sample this process's user pc hz times a second of its user
+// time into NUPROF buckets of 1<<shift bytes each, from zero
+// counts; or stop and discard the counts if hz is 0.
+int
+uprof(int shift, int hz)
+{
+  struct proc *p = myproc();
+  struct uprof *u;
+
+  if(hz < 0 || hz > 10000 || shift < 0 || shift > 32)
+    return -1;
+  uprofree(p);
+  if(hz == 0)
+    return 0;
+  if((u = (struct uprof*)kalloc()) == 0)
+    return -1;
+  memset(u, 0, sizeof(*u));
+  for(int i = 0; i < UPROFPAGES; i++){
+    if((u->pg[i] = (uint*)kalloc()) == 0){
+      p->uprof = u;
+      uprofree(p);
+      return -1;
+    }
+    memset(u->pg[i], 0, PGSIZE);
+  }
+  u->interval = TIMEBASE / hz;
+  u->next = p->utime + u->interval;
+  u->shift = shift;
+  // no lock: only this process's hart looks at p->uprof.
+  p->uprof = u;
+  return 0;
+}
+
+// Copy up to n of the counts of pid, which must be this process
+// or an exited child that hasn't been waited for, to the user
+// array at addr. Returns the number copied.
+int
+uprofread(int pid, uint64 addr, int n)
+{
+  struct proc *p = myproc(), *cp;
+  struct uprof *u;
+  int i, m, r = -1;
+
+  acquire(&wait_lock);
+  if(pid == p->pid)
+    cp = p;
+  else
+    for(cp = p->children; cp; cp = cp->sibling){
+      acquire(&cp->lock);
+      if(cp->pid == pid && cp->state == ZOMBIE){
+        release(&cp->lock);
+        break;
+      }
+      release(&cp->lock);
+    }
+  // a zombie's histogram stays put until wait() frees it,
+  // which needs wait_lock.
+  if(cp == 0 || (u = cp->uprof) == 0)
+    goto out;
+  if(n > NUPROF)
+    n = NUPROF;
+  for(i = 0; i < n; i += m){
+    m = PGSIZE/sizeof(uint) - i % (PGSIZE/sizeof(uint));
+    if(m > n - i)
+      m = n - i;
+    if(copyout(p->pagetable, addr + i*sizeof(uint),
+               (char*)&u->pg[i / (PGSIZE/sizeof(uint))][i % (PGSIZE/sizeof(uint))],
+               m*sizeof(uint)) < 0)
+      goto out;
+  }
+  r = n < 0 ? 0 : n;
+out:
+  release(&wait_lock);
+  return r;
+}
+
+uint64
+sys_uprof(void) {
+  int shift, hz;
+
+  argint(0, &shift);
+  argint(1, &hz);
+  return uprof(shift, hz);
+}
+
+uint64
+sys_uprofread(void) {
+  int pid, n;
+  uint64 addr;
+
+  argint(0, &pid);
+  argaddr(1, &addr);
+  argint(2, &n);
+  return uprofread(pid, addr, n);
+}
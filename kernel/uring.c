@@ -0,0 +1,205 @@
+// Submission and completion rings shared with user space, so a
+// process can make many system calls with one trap. See uring.h.
+//
+// uring_enter() copies each submission out of the shared page
+// before it looks at it, since the process may change the page
+// at any time, and keeps its own copies of the indexes the
+// kernel writes. Entries run either inline, one after another,
+// or on a kernel thread of the process, which kthread() makes
+// at uring_setup() time.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "timer.h"
+#include "proc.h"
+#include "uring.h"
+#include "defs.h"
+
+// The kernel's side of a process's rings; one page, private to
+// the kernel, for each tgroup that called uring_setup().
+struct uringstate {
+  struct spinlock lock;
+  struct uring *ring;          // the shared page, mapped at URING
+  uint sqhead;                 // next submission to take
+  uint cqtail;                 // next completion to fill
+  int inflight;                // taken, but not yet completed
+  int worker;                  // whether the kernel thread is running
+  uint aqhead;                 // URING_ASYNC entries for the thread,
+  uint aqtail;                 //   from aq[aqhead] to aq[aqtail-1]
+  struct uring_sqe aq[URING_ENTRIES];
+};
+
+// Post the completion of a taken entry.
+// Caller must hold u->lock.
+static void
+uringpost(struct uringstate *u, uint64 user_data, uint64 res)
+{
+  struct uring_cqe *cqe = &u->ring->cq[u->cqtail % URING_ENTRIES];
+
+  cqe->user_data = user_data;
+  cqe->res = res;
+  u->cqtail++;
+  __atomic_store_n(&u->ring->cqtail, u->cqtail, __ATOMIC_RELEASE);
+  u->inflight--;
+  wakeup(&u->cqtail);
+}
+
+// The kernel thread: run URING_ASYNC entries in order until
+// killed, then fail the ones left.
+static void
+uringworker(void)
+{
+  struct proc *p = myproc();
+  struct uringstate *u = p->tg->uring;
+  struct uring_sqe sqe;
+  uint64 res;
+
+  // Still holding p->lock from scheduler.
+  release(&p->lock);
+
+  acquire(&u->lock);
+  for(;;){
+    while(u->aqhead == u->aqtail && !killed(p))
+      sleep(&u->aqtail, &u->lock);
+    if(killed(p))
+      break;
+    sqe = u->aq[u->aqhead++ % URING_ENTRIES];
+    release(&u->lock);
+    res = syscallrun(sqe.op, sqe.args);
+    acquire(&u->lock);
+    uringpost(u, sqe.user_data, res);
+  }
+  // uring_enter() runs them all inline from now on.
+  u->worker = 0;
+  while(u->aqhead != u->aqtail){
+    sqe = u->aq[u->aqhead++ % URING_ENTRIES];
+    uringpost(u, sqe.user_data, -1);
+  }
+  release(&u->lock);
+  exit(0);
+}
+
+// Give the process a pair of rings, mapped at URING, and a
+// kernel thread to run URING_ASYNC entries.
+// Return URING, or -1 if it has rings already or memory is short.
+static uint64
+uring_setup(void)
+{
+  struct tgroup *tg = myproc()->tg;
+  struct uringstate *u;
+
+  if((u = (struct uringstate*)kalloc()) == 0)
+    return -1;
+  if((u->ring = (struct uring*)kalloc()) == 0){
+    kfree(u);
+    return -1;
+  }
+  memset(u->ring, 0, PGSIZE);
+  initlock(&u->lock, "uring");
+  u->sqhead = u->cqtail = 0;
+  u->inflight = 0;
+  u->aqhead = u->aqtail = 0;
+  u->worker = 1;
+
+  acquire(&tg->lock);
+  if(tg->uring != 0 ||
+     mappages(tg->pagetable, URING, PGSIZE, (uint64)u->ring,
+              PTE_R | PTE_W | PTE_U) < 0){
+    release(&tg->lock);
+    kfree(u->ring);
+    kfree(u);
+    return -1;
+  }
+  tg->uring = u;
+  release(&tg->lock);
+
+  // without the thread, URING_ASYNC entries run inline.
+  if(kthread(uringworker, "uring") < 0){
+    acquire(&u->lock);
+    u->worker = 0;
+    release(&u->lock);
+  }
+  return URING;
+}
+
+// Take up to to_submit entries from the submission ring and run
+// them, then wait until min_complete completions are ready, or
+// none are to come. Return the number of entries taken.
+static int
+uring_enter(int to_submit, int min_complete)
+{
+  struct proc *p = myproc();
+  struct uringstate *u = p->tg->uring;
+  struct uring *r;
+  struct uring_sqe sqe;
+  uint64 res;
+  int n;
+
+  if(u == 0)
+    return -1;
+  r = u->ring;
+
+  for(n = 0; n < to_submit && !killed(p); n++){
+    acquire(&u->lock);
+    // take an entry only if its completion will have room.
+    if(u->sqhead == __atomic_load_n(&r->sqtail, __ATOMIC_ACQUIRE) ||
+       u->cqtail + u->inflight - __atomic_load_n(&r->cqhead, __ATOMIC_RELAXED)
+       >= URING_ENTRIES){
+      release(&u->lock);
+      break;
+    }
+    sqe = r->sq[u->sqhead % URING_ENTRIES];
+    u->sqhead++;
+    __atomic_store_n(&r->sqhead, u->sqhead, __ATOMIC_RELEASE);
+    u->inflight++;
+    if((sqe.flags & URING_ASYNC) && u->worker){
+      u->aq[u->aqtail++ % URING_ENTRIES] = sqe;
+      wakeup(&u->aqtail);
+      release(&u->lock);
+      continue;
+    }
+    release(&u->lock);
+
+    res = syscallrun(sqe.op, sqe.args);
+    acquire(&u->lock);
+    uringpost(u, sqe.user_data, res);
+    release(&u->lock);
+  }
+
+  acquire(&u->lock);
+  while((int)(u->cqtail - __atomic_load_n(&r->cqhead, __ATOMIC_RELAXED))
+        < min_complete && u->inflight > 0 && !killed(p))
+    sleep(&u->cqtail, &u->lock);
+  release(&u->lock);
+  return n;
+}
+
+// Free tg's rings, as its last thread exits.
+void
+uringfree(struct tgroup *tg)
+{
+  if(tg->uring == 0)
+    return;
+  uvmunmap(tg->pagetable, URING, 1, 1);
+  kfree((void*)tg->uring);
+  tg->uring = 0;
+}
+
+uint64
+sys_uring_setup(void)
+{
+  return uring_setup();
+}
+
+uint64
+sys_uring_enter(void)
+{
+  int to_submit, min_complete;
+
+  argint(0, &to_submit);
+  argint(1, &min_complete);
+  return uring_enter(to_submit, min_complete);
+}
@@ -0,0 +1,41 @@
+// A submission ring and a completion ring, shared between a
+// process and the kernel in the page uring_setup() maps at URING,
+// so one uring_enter() can run many system calls.
+//
+// The process fills sq[sqtail % URING_ENTRIES] and then bumps
+// sqtail; the kernel takes entries from sqhead up. Each entry
+// names a system call by its SYS_ number, with up to three
+// arguments, and gets a completion with the call's return value
+// in cq[cqtail % URING_ENTRIES], which the kernel fills and the
+// process consumes from cqhead up. Indexes only ever grow; each
+// side writes only its own two, after the entries they cover.
+// The kernel keeps no more entries in flight than there is room
+// for completions, so sq entries wait while the cq is full.
+//
+// Entries run in order as uring_enter() takes them, unless
+// flagged URING_ASYNC: those run, in order, on a kernel thread
+// of the process, so that uring_enter() can return, or submit
+// more, while they wait for the disk.
+#define URING_ENTRIES 64
+#define URING_ASYNC   1        // sqe flag: run on the uring's kernel thread
+
+struct uring_sqe {
+  int op;                      // SYS_read, SYS_write, ...
+  int flags;                   // URING_*
+  uint64 args[3];
+  uint64 user_data;            // copied to the completion
+};
+
+struct uring_cqe {
+  uint64 user_data;
+  uint64 res;                  // the call's return value
+};
+
+struct uring {
+  uint sqhead;                 // written by the kernel
+  uint sqtail;                 // written by the process
+  uint cqhead;                 // written by the process
+  uint cqtail;                 // written by the kernel
+  struct uring_sqe sq[URING_ENTRIES];
+  struct uring_cqe cq[URING_ENTRIES];
+};
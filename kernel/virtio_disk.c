@@ -58,12 +58,16 @@ static struct disk {
   
 } disk;
 
+static int ksread, kswrite;  // kstat counters
+
 void
 virtio_disk_init(void)
 {
   uint32 status = 0;
 
   initlock(&disk.vdisk_lock, "virtio_disk");
+  ksread = kstat_register("disk_read");
+  kswrite = kstat_register("disk_write");
 
   if(*R(VIRTIO_MMIO_MAGIC_VALUE) != 0x74726976 ||
      *R(VIRTIO_MMIO_VERSION) != 2 ||
@@ -217,6 +221,7 @@ virtio_disk_rw(struct buf *b, int write)
 {
   uint64 sector = b->blockno * (BSIZE / 512);
 
+  kstat_add(write ? kswrite : ksread, 1);
   acquire(&disk.vdisk_lock);
 
   // the spec's Section 5.2 says that legacy block operations use
@@ -128,15 +128,24 @@ main(int argc, char *argv[])
   iappend(rootino, &de, sizeof(de));
 
   for(i = 2; i < argc; i++){
-    // get rid of "user/"
+    // get rid of "user/" or "kernel/"
     char *shortname;
     if(strncmp(argv[i], "user/", 5) == 0)
       shortname = argv[i] + 5;
+    else if(strncmp(argv[i], "kernel/", 7) == 0)
+      shortname = argv[i] + 7;
     else
       shortname = argv[i];
     
     assert(index(shortname, '/') == 0);
 
+    // a program's symbols are only a convenience, so leave
+    // out those whose names don't fit, like affinitytest.sym.
+    if(strlen(shortname) > DIRSIZ && strstr(shortname, ".sym")){
+      fprintf(stderr, "mkfs: %s: name too long, skipped\n", shortname);
+      continue;
+    }
+
     if((fd = open(argv[i], 0)) < 0)
       die(argv[i]);
 
@@ -0,0 +1,82 @@
+//
+// test the setaffinity() and getaffinity() syscalls.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+void
+fail(char *msg)
+{
+  printf("affinitytest: %s\n", msg);
+  exit(1);
+}
+
+void
+spin(void)
+{
+  volatile int n = 0;
+
+  for(int i = 0; i < 10000000; i++)
+    n++;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid, all, status, i, n;
+
+  all = getaffinity(getpid());
+  if(all != ALLCPUS)
+    fail("new process may not run everywhere");
+  if(getaffinity(-1) != -1)
+    fail("getaffinity of a bad pid succeeded");
+  if(setaffinity(-1, 1) != -1)
+    fail("setaffinity of a bad pid succeeded");
+  if(setaffinity(getpid(), 0) != -1)
+    fail("empty mask accepted");
+
+  // pin to cpu 0, which always runs; a child inherits the mask.
+  if(setaffinity(getpid(), 1) < 0)
+    fail("setaffinity failed");
+  if(getaffinity(getpid()) != 1)
+    fail("getaffinity does not match setaffinity");
+  pid = fork();
+  if(pid < 0)
+    fail("fork failed");
+  if(pid == 0)
+    exit(getaffinity(getpid()) == 1 ? 0 : 1);
+  wait(&status);
+  if(status != 0)
+    fail("child did not inherit the mask");
+
+  // one spinning child pinned to each cpu; each must get to run
+  // on its own cpu and finish.
+  n = 0;
+  for(i = 0; i < NCPU; i++){
+    pid = fork();
+    if(pid < 0)
+      fail("fork failed");
+    if(pid == 0){
+      if(setaffinity(getpid(), 1 << i) < 0)
+        exit(2);  // cpu i isn't running
+      spin();
+      exit(getaffinity(getpid()) == (1 << i) ? 0 : 1);
+    }
+  }
+  for(i = 0; i < NCPU; i++){
+    wait(&status);
+    if(status == 1)
+      fail("pinned child lost its mask");
+    if(status == 0)
+      n++;
+  }
+  printf("affinitytest: pinned a process to each of %d cpus\n", n);
+
+  // back to every cpu.
+  if(setaffinity(getpid(), all) < 0 || getaffinity(getpid()) != all)
+    fail("could not restore the mask");
+  printf("affinitytest: OK\n");
+  exit(0);
+}
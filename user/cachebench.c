@@ -0,0 +1,83 @@
+//
+// false sharing between cpus: a process on each cpu grows and
+// shrinks its memory with sbrk() as fast as it can for a second,
+// which allocates and frees pages from its own cpu's free list,
+// and traps through its own struct cpu and struct proc. nothing
+// is shared, so each cpu should do about as well alone as with
+// the others running; where it does worse, cpus are fighting
+// over cache lines. run once with 1 cpu, then with all:
+//   cachebench [ncpu]
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+#define BENCHTICKS 10
+#define NPAGES 8
+
+int
+main(int argc, char *argv[])
+{
+  int fds[2], cpus[NCPU], counts[NCPU], ncpu = 0, max, i, n;
+  int start, total;
+
+  max = argc > 1 ? atoi(argv[1]) : NCPU;
+  for(i = 0; i < NCPU && ncpu < max; i++)
+    if(setaffinity(getpid(), 1 << i) == 0)
+      cpus[ncpu++] = i;  // only online cpus are accepted
+  setaffinity(getpid(), ALLCPUS);
+  if(ncpu == 0){
+    fprintf(2, "cachebench: no cpus\n");
+    exit(1);
+  }
+
+  if(pipe(fds) < 0){
+    fprintf(2, "cachebench: pipe failed\n");
+    exit(1);
+  }
+  // everyone starts on the same tick boundary.
+  start = uptime() + 2;
+  for(i = 0; i < ncpu; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "cachebench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      setaffinity(getpid(), 1 << cpus[i]);
+      while(uptime() < start)
+        ;
+      for(n = 0; uptime() < start + BENCHTICKS; n += NPAGES){
+        if(sbrk(NPAGES * PGSIZE) == (char*)-1){
+          fprintf(2, "cachebench: sbrk failed\n");
+          exit(1);
+        }
+        sbrk(-NPAGES * PGSIZE);
+      }
+      write(fds[1], &i, sizeof(i));
+      write(fds[1], &n, sizeof(n));
+      exit(0);
+    }
+  }
+  for(i = 0; i < ncpu; i++){
+    int j;
+    read(fds[0], &j, sizeof(j));
+    read(fds[0], &counts[j], sizeof(counts[j]));
+  }
+  for(i = 0; i < ncpu; i++)
+    wait(0);
+
+  total = 0;
+  for(i = 0; i < ncpu; i++){
+    // ns per page, from BENCHTICKS tenths of a second.
+    printf("cpu %d: %d pages/s, %d ns each\n", cpus[i],
+           counts[i] * 10 / BENCHTICKS,
+           counts[i] ? BENCHTICKS * 100000000 / counts[i] : 0);
+    total += counts[i];
+  }
+  printf("%d cpus: %d pages/s in all, %d per cpu\n",
+         ncpu, total * 10 / BENCHTICKS, total * 10 / BENCHTICKS / ncpu);
+  exit(0);
+}
@@ -0,0 +1,107 @@
+//
+// benchmark for the proportional-share scheduler.
+//
+// build the kernel with the weighted fair scheduler and give
+// it a single cpu, so that the workers have to compete:
+//   make CPUS=1 SCHED=FAIR qemu
+// each worker spins for the same wall-clock interval under a
+// different weight. the share of the loop iterations a worker
+// completes is its share of the cpu, and should match its share
+// of the total weight.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define NWORKER  3
+#define DURATION 50    // ticks, about five seconds
+#define TOLERANCE 3    // allowed error, in percent of the cpu
+
+int weights[NWORKER] = { DEFWEIGHT, 2*DEFWEIGHT, 4*DEFWEIGHT };
+
+// spin until ticks reach end, returning the number of
+// iterations completed.
+uint64
+spin(int end)
+{
+  volatile uint64 n = 0;
+
+  while(uptime() < end){
+    for(int i = 0; i < 100000; i++)
+      n++;
+  }
+  return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int go[2], result[2];
+  uint64 counts[NWORKER], total;
+  int i, start, sumw, worst;
+
+  if(pipe(go) < 0 || pipe(result) < 0){
+    printf("fairbench: pipe failed\n");
+    exit(1);
+  }
+
+  for(i = 0; i < NWORKER; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("fairbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      if(setweight(getpid(), weights[i]) < 0){
+        printf("fairbench: setweight failed\n");
+        exit(1);
+      }
+      // wait for the parent to start everyone at once.
+      read(go[0], &start, sizeof(start));
+      uint64 n = spin(start + DURATION);
+      write(result[1], &i, sizeof(i));
+      write(result[1], &n, sizeof(n));
+      exit(0);
+    }
+  }
+
+  start = uptime() + 1;
+  for(i = 0; i < NWORKER; i++)
+    write(go[1], &start, sizeof(start));
+
+  total = 0;
+  for(i = 0; i < NWORKER; i++){
+    int w;
+    uint64 n;
+    read(result[0], &w, sizeof(w));
+    read(result[0], &n, sizeof(n));
+    counts[w] = n;
+    total += n;
+  }
+  for(i = 0; i < NWORKER; i++)
+    wait(0);
+
+  sumw = 0;
+  for(i = 0; i < NWORKER; i++)
+    sumw += weights[i];
+
+  worst = 0;
+  for(i = 0; i < NWORKER; i++){
+    // shares in tenths of a percent.
+    int got = counts[i] * 1000 / total;
+    int want = weights[i] * 1000 / sumw;
+    int err = got > want ? got - want : want - got;
+    if(err > worst)
+      worst = err;
+    printf("weight %d: %d.%d%% of cpu (expected %d.%d%%)\n",
+           weights[i], got / 10, got % 10, want / 10, want % 10);
+  }
+
+  if(worst <= TOLERANCE*10){
+    printf("fairbench: OK, worst error %d.%d%%\n", worst / 10, worst % 10);
+    exit(0);
+  }
+  printf("fairbench: FAILED, worst error %d.%d%%\n", worst / 10, worst % 10);
+  exit(1);
+}
@@ -0,0 +1,197 @@
+//
+// test futex_wait()/futex_wake() and the mutexes, condition
+// variables and semaphores built on them.
+//
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define NTHR   4
+#define NITER  20000
+#define NITEM  1000
+
+void
+fail(char *msg)
+{
+  printf("futextest: %s\n", msg);
+  exit(1);
+}
+
+// futex_wait() must not sleep when the value has changed,
+// and must reject a bad address.
+void
+basics(void)
+{
+  int x = 1;
+
+  printf("futex basics: ");
+  if(futex_wait(&x, 0) != -1)
+    fail("futex_wait slept on a stale value");
+  if(futex_wait((int*)((char*)&x + 1), 1) != -1)
+    fail("futex_wait accepted a misaligned address");
+  if(futex_wake(&x, 1) != 0)
+    fail("futex_wake woke someone");
+  printf("OK\n");
+}
+
+volatile int flag;
+
+int
+flagwaiter(void *arg)
+{
+  while(flag == 0)
+    futex_wait((int*)&flag, 0);
+  return flag;
+}
+
+// a sleeping thread is woken by futex_wake().
+void
+wakeup(void)
+{
+  int tid, status, n;
+
+  printf("futex wake: ");
+  flag = 0;
+  if((tid = thread_create(flagwaiter, 0)) < 0)
+    fail("thread_create failed");
+  sleep(2);  // let it go to sleep
+  flag = 7;
+  n = futex_wake((int*)&flag, 1);
+  if(thread_join(tid, &status) != tid || status != 7)
+    fail("waiter did not see the wake-up");
+  if(n != 1)
+    printf("(waiter had not slept) ");
+  printf("OK\n");
+}
+
+struct mutex m;
+int counter;
+
+int
+incr(void *arg)
+{
+  for(int i = 0; i < NITER; i++){
+    mutex_lock(&m);
+    counter++;
+    mutex_unlock(&m);
+  }
+  return 0;
+}
+
+void
+mutexes(void)
+{
+  int tids[NTHR];
+
+  printf("mutex: ");
+  mutex_init(&m);
+  counter = 0;
+  for(int i = 0; i < NTHR; i++)
+    if((tids[i] = thread_create(incr, 0)) < 0)
+      fail("thread_create failed");
+  for(int i = 0; i < NTHR; i++)
+    thread_join(tids[i], 0);
+  if(counter != NTHR*NITER)
+    fail("lost an increment");
+  if(mutex_trylock(&m) != 0 || mutex_trylock(&m) != -1)
+    fail("trylock");
+  mutex_unlock(&m);
+  printf("OK\n");
+}
+
+// a one-slot buffer guarded by a mutex and condition variable.
+struct cond cv;
+int slot, full;
+
+int
+producer(void *arg)
+{
+  for(int i = 1; i <= NITEM; i++){
+    mutex_lock(&m);
+    while(full)
+      cond_wait(&cv, &m);
+    slot = i;
+    full = 1;
+    cond_broadcast(&cv);
+    mutex_unlock(&m);
+  }
+  return 0;
+}
+
+void
+condvars(void)
+{
+  int tid, sum = 0;
+
+  printf("condition variable: ");
+  mutex_init(&m);
+  cond_init(&cv);
+  full = 0;
+  if((tid = thread_create(producer, 0)) < 0)
+    fail("thread_create failed");
+  for(int i = 1; i <= NITEM; i++){
+    mutex_lock(&m);
+    while(!full)
+      cond_wait(&cv, &m);
+    if(slot != i)
+      fail("item out of order");
+    sum += slot;
+    full = 0;
+    cond_broadcast(&cv);
+    mutex_unlock(&m);
+  }
+  thread_join(tid, 0);
+  if(sum != NITEM*(NITEM+1)/2)
+    fail("wrong sum");
+  printf("OK\n");
+}
+
+struct sem items, spaces;
+int ring[4], ringsum;
+
+int
+poster(void *arg)
+{
+  for(int i = 0; i < NITEM; i++){
+    sem_wait(&spaces);
+    ring[i % 4] = i;
+    sem_post(&items);
+  }
+  return 0;
+}
+
+void
+semaphores(void)
+{
+  int tid;
+
+  printf("semaphore: ");
+  sem_init(&items, 0);
+  sem_init(&spaces, 4);
+  ringsum = 0;
+  if((tid = thread_create(poster, 0)) < 0)
+    fail("thread_create failed");
+  for(int i = 0; i < NITEM; i++){
+    sem_wait(&items);
+    if(ring[i % 4] != i)
+      fail("item out of order");
+    ringsum += ring[i % 4];
+    sem_post(&spaces);
+  }
+  thread_join(tid, 0);
+  if(ringsum != NITEM*(NITEM-1)/2)
+    fail("wrong sum");
+  printf("OK\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  basics();
+  wakeup();
+  mutexes();
+  condvars();
+  semaphores();
+  printf("futextest: all tests passed\n");
+  exit(0);
+}
@@ -0,0 +1,181 @@
+//
+// profile the kernel while a command runs, and report the
+// functions that the timer interrupt most often found running,
+// or with -f print a folded stack per sample, for flamegraph.pl.
+//   kprof [-f] [-r hz] command [arg ...]
+// samples are taken on every cpu, whatever it is running.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/signal.h"
+#include "kernel/kprof.h"
+#include "user/user.h"
+
+#define NREAD 64
+#define NTOP 25
+
+struct symtab syms;
+int *self, *total;        // samples per symbol: running, or on the stack
+int nsample, nuser, nunknown;
+int folded;
+volatile int done;
+
+struct kprofsample buf[NREAD];
+
+void
+onchild(int sig)
+{
+  done = 1;
+  sigreturn();
+}
+
+// count a kernel sample once against each function on its
+// stack, however often recursion puts it there.
+void
+count(struct kprofsample *s)
+{
+  int seen[KPROFDEPTH + 1], nseen = 0, i, j, k;
+
+  for(i = -1; i < s->depth; i++){
+    // a return address is just after its call instruction.
+    k = symindex(&syms, i < 0 ? s->pc : s->stack[i] - 4);
+    if(k < 0){
+      if(i < 0)
+        nunknown++;
+      continue;
+    }
+    if(i < 0)
+      self[k]++;
+    for(j = 0; j < nseen && seen[j] != k; j++)
+      ;
+    if(j == nseen){
+      seen[nseen++] = k;
+      total[k]++;
+    }
+  }
+}
+
+void
+fold(struct kprofsample *s)
+{
+  if(s->user){
+    printf("user 1\n");
+    return;
+  }
+  for(int i = s->depth - 1; i >= 0; i--)
+    printf("%s;", symname(&syms, s->stack[i] - 4));
+  printf("%s 1\n", symname(&syms, s->pc));
+}
+
+void
+drain(void)
+{
+  int n, i;
+
+  while((n = kprofread(buf, NREAD)) > 0){
+    for(i = 0; i < n; i++){
+      nsample++;
+      if(folded)
+        fold(&buf[i]);
+      else if(buf[i].user)
+        nuser++;
+      else
+        count(&buf[i]);
+    }
+  }
+}
+
+void
+report(int dropped)
+{
+  int i, j, best, nkernel;
+
+  nkernel = nsample - nuser;
+  printf("kprof: %d samples, %d in user space, %d dropped\n",
+         nsample, nuser, dropped);
+  if(nkernel == 0)
+    return;
+  printf("self\tself%%\ttotal\tfunction\n");
+  for(j = 0; j < NTOP; j++){
+    best = -1;
+    for(i = 0; i < syms.n; i++)
+      if(self[i] > 0 && (best < 0 || self[i] > self[best]))
+        best = i;
+    if(best < 0)
+      break;
+    printf("%d\t%d%%\t%d\t%s\n", self[best], self[best] * 100 / nkernel,
+           total[best], syms.name[best]);
+    self[best] = 0;
+  }
+  if(nunknown)
+    printf("%d\t%d%%\t\t?\n", nunknown, nunknown * 100 / nkernel);
+}
+
+void
+usage(void)
+{
+  fprintf(2, "usage: kprof [-f] [-r hz] command [arg ...]\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int hz = 1000, i, pid, dropped;
+
+  for(i = 1; i < argc && argv[i][0] == '-'; i++){
+    if(strcmp(argv[i], "-f") == 0)
+      folded = 1;
+    else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+      hz = atoi(argv[++i]);
+    else
+      usage();
+  }
+  if(i == argc)
+    usage();
+
+  if(symload(&syms, "/kernel.sym") < 0){
+    fprintf(2, "kprof: cannot read /kernel.sym\n");
+    exit(1);
+  }
+  self = malloc(syms.n * sizeof(int));
+  total = malloc(syms.n * sizeof(int));
+  memset(self, 0, syms.n * sizeof(int));
+  memset(total, 0, syms.n * sizeof(int));
+
+  // samples left from an earlier run would skew this one.
+  kprofctl(0);
+  while(kprofread(buf, NREAD) > 0)
+    ;
+
+  sigaction(SIGCHLD, onchild);
+  if(kprofctl(hz) < 0){
+    fprintf(2, "kprof: bad rate %d\n", hz);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "kprof: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[i], argv + i);
+    fprintf(2, "kprof: exec %s failed\n", argv[i]);
+    exit(1);
+  }
+
+  // the rings hold a quarter second at 1000hz; empty them
+  // every tick until the command exits.
+  while(!done){
+    sleep(1);
+    drain();
+  }
+  dropped = kprofctl(0);
+  drain();
+  wait(0);
+
+  if(!folded)
+    report(dropped);
+  exit(0);
+}
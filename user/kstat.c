@@ -0,0 +1,43 @@
+//
+// report kernel event counts: syscalls, page faults, context
+// switches, buffer cache hits and misses, disk reads and writes.
+//   kstat [command [arg ...]]
+// with a command, report the events while it runs; without,
+// the counts since boot.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/kstat.h"
+#include "user/user.h"
+
+struct kstat before[NKSTAT], after[NKSTAT];
+
+int
+main(int argc, char *argv[])
+{
+  int n, i, pid;
+
+  if(argc > 1){
+    kstat(before, NKSTAT);
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "kstat: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[1], argv + 1);
+      fprintf(2, "kstat: exec %s failed\n", argv[1]);
+      exit(1);
+    }
+    wait(0);
+  }
+  // counters registered at boot, so before and after match.
+  if((n = kstat(after, NKSTAT)) < 0){
+    fprintf(2, "kstat: kstat failed\n");
+    exit(1);
+  }
+  for(i = 0; i < n; i++)
+    printf("%lu\t%s\n", after[i].value - before[i].value, after[i].name);
+  exit(0);
+}
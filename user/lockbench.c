@@ -0,0 +1,88 @@
+//
+// spinlock contention: a process on each cpu dup()s and
+// close()s a file, each of which takes ftable.lock, as fast as
+// it can for a second, and the acquires each made show the
+// lock's throughput and fairness. with -r each calls
+// getaffinity() instead, which looks up its pid with pid_lock
+// held for reading, and the readers shouldn't slow each other.
+//   lockbench [-r] [ncpu]
+// compare kernels built with make LOCK=TICKET, MCS or TAS,
+// with CPUS=8.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define BENCHTICKS 10
+
+int
+main(int argc, char *argv[])
+{
+  int fds[2], cpus[NCPU], counts[NCPU], ncpu = 0, max, i, n;
+  int start, min, hi, total, readers = 0;
+
+  if(argc > 1 && strcmp(argv[1], "-r") == 0){
+    readers = 1;
+    argc--;
+    argv++;
+  }
+  max = argc > 1 ? atoi(argv[1]) : NCPU;
+  for(i = 0; i < NCPU && ncpu < max; i++)
+    if(setaffinity(getpid(), 1 << i) == 0)
+      cpus[ncpu++] = i;  // only online cpus are accepted
+  setaffinity(getpid(), ALLCPUS);
+  if(ncpu == 0){
+    fprintf(2, "lockbench: no cpus\n");
+    exit(1);
+  }
+
+  if(pipe(fds) < 0){
+    fprintf(2, "lockbench: pipe failed\n");
+    exit(1);
+  }
+  // everyone starts on the same tick boundary.
+  start = uptime() + 2;
+  for(i = 0; i < ncpu; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "lockbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      setaffinity(getpid(), 1 << cpus[i]);
+      while(uptime() < start)
+        ;
+      if(readers)
+        for(n = 0; uptime() < start + BENCHTICKS; n++)
+          getaffinity(getpid());
+      else
+        for(n = 0; uptime() < start + BENCHTICKS; n += 2)
+          close(dup(fds[1]));
+      write(fds[1], &i, sizeof(i));
+      write(fds[1], &n, sizeof(n));
+      exit(0);
+    }
+  }
+  for(i = 0; i < ncpu; i++){
+    int j;
+    read(fds[0], &j, sizeof(j));
+    read(fds[0], &counts[j], sizeof(counts[j]));
+  }
+  for(i = 0; i < ncpu; i++)
+    wait(0);
+
+  total = 0;
+  min = hi = counts[0];
+  for(i = 0; i < ncpu; i++){
+    printf("cpu %d: %d acquires/s\n", cpus[i], counts[i] * 10 / BENCHTICKS);
+    total += counts[i];
+    if(counts[i] < min)
+      min = counts[i];
+    if(counts[i] > hi)
+      hi = counts[i];
+  }
+  printf("%d cpus: %d acquires/s in all; slowest cpu got %d%% of the fastest\n",
+         ncpu, total * 10 / BENCHTICKS, hi ? min * 100 / hi : 0);
+  exit(0);
+}
@@ -0,0 +1,73 @@
+//
+// report kernel lock contention while a command runs: the
+// locks whose acquires most often had to wait.
+//   lockstat [command [arg ...]]
+// with no command, report the counts since boot. the kernel
+// keeps them only if built with make LOCKSTAT=1.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+#define NSTAT 64
+#define NTOP  20
+
+struct lockstat stats[NSTAT];
+
+// cycles to microseconds
+uint64
+us(uint64 t)
+{
+  return t / (TIMEBASE / 1000000);
+}
+
+void
+report(int n)
+{
+  int i, j, best;
+
+  printf("contended\tacquires\tspins\tavg us\tmax us\tlocks\tname\n");
+  for(j = 0; j < NTOP; j++){
+    best = -1;
+    for(i = 0; i < n; i++)
+      if(stats[i].acquires > 0 &&
+         (best < 0 || stats[i].contended > stats[best].contended))
+        best = i;
+    if(best < 0)
+      break;
+    struct lockstat *s = &stats[best];
+    printf("%lu\t\t%lu\t\t%lu\t%lu\t%lu\t%d\t%s%s\n",
+           s->contended, s->acquires, s->spins, us(s->holdtime / s->acquires),
+           us(s->maxhold), s->nlocks, s->name, s->sleep ? " (sleep)" : "");
+    s->acquires = 0;
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, pid;
+
+  if(argc > 1){
+    lockstat(0, 0, 1);
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "lockstat: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[1], argv + 1);
+      fprintf(2, "lockstat: exec %s failed\n", argv[1]);
+      exit(1);
+    }
+    wait(0);
+  }
+  if((n = lockstat(stats, NSTAT, 0)) < 0){
+    fprintf(2, "lockstat: lockstat failed; is the kernel built with LOCKSTAT=1?\n");
+    exit(1);
+  }
+  report(n);
+  exit(0);
+}
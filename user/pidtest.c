@@ -0,0 +1,90 @@
+//
+// test kill() and wait() by pid, and reparenting,
+// with many processes alive at once.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define NCHILD 100   // more than fit in the old, fixed proc table
+
+void
+fail(char *msg)
+{
+  printf("pidtest: %s\n", msg);
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pids[NCHILD], seen[NCHILD];
+  int i, j, pid, n;
+
+  printf("kill and wait: ");
+  for(i = 0; i < NCHILD; i++){
+    if((pid = fork()) < 0)
+      fail("fork failed");
+    if(pid == 0){
+      for(;;)
+        sleep(100);
+    }
+    pids[i] = pid;
+    seen[i] = 0;
+  }
+  // kill in reverse order of creation.
+  for(i = NCHILD-1; i >= 0; i--)
+    if(kill(pids[i]) < 0)
+      fail("kill of a live child failed");
+  for(n = 0; n < NCHILD; n++){
+    if((pid = wait(0)) < 0)
+      fail("wait lost a child");
+    for(j = 0; j < NCHILD && pids[j] != pid; j++)
+      ;
+    if(j == NCHILD || seen[j]++)
+      fail("wait returned a bad pid");
+  }
+  if(wait(0) != -1)
+    fail("wait found an extra child");
+  for(i = 0; i < NCHILD; i++)
+    if(kill(pids[i]) != -1)
+      fail("kill of a reaped child succeeded");
+  if(kill(0) != -1 || kill(-1) != -1)
+    fail("kill of a bad pid succeeded");
+  printf("OK\n");
+
+  // a grandchild outlives its parent and passes to init;
+  // it must still be killable by pid, and init must reap it.
+  printf("reparent: ");
+  int fds[2], gpid;
+  if(pipe(fds) < 0)
+    fail("pipe failed");
+  if((pid = fork()) < 0)
+    fail("fork failed");
+  if(pid == 0){
+    if((gpid = fork()) == 0){
+      for(;;)
+        sleep(100);
+    }
+    write(fds[1], &gpid, sizeof(gpid));
+    exit(0);
+  }
+  if(wait(0) != pid)
+    fail("wait failed");
+  if(read(fds[0], &gpid, sizeof(gpid)) != sizeof(gpid) || gpid < 0)
+    fail("grandchild fork failed");
+  close(fds[0]);
+  close(fds[1]);
+  if(kill(gpid) < 0)
+    fail("kill of a reparented grandchild failed");
+  // once init has reaped it, its pid is gone.
+  for(i = 0; i < 50 && kill(gpid) == 0; i++)
+    sleep(1);
+  if(i == 50)
+    fail("init did not reap the grandchild");
+  printf("OK\n");
+
+  printf("pidtest: all tests passed\n");
+  exit(0);
+}
@@ -1,9 +1,59 @@
 #include "kernel/types.h"
 #include "user/user.h"
 
-int main() {
+#define BENCHTICKS 10
+
+// Bounce a byte between parent and child for BENCHTICKS ticks,
+// the parent on the cpus in pmask and the child on those in
+// cmask, and print the round trips per second.
+void bench(char *what, int pmask, int cmask) {
+    int ping[2], pong[2];
+    int n = 0, t0, pid;
+    char c = 0;
+
+    pipe(ping);
+    pipe(pong);
+    if ((pid = fork()) == 0) {
+        setaffinity(getpid(), cmask);
+        while (read(ping[0], &c, 1) == 1 && c)
+            write(pong[1], &c, 1);
+        exit(0);
+    }
+    setaffinity(getpid(), pmask);
+
+    t0 = uptime();
+    while (uptime() == t0)
+        ;
+    t0++;
+    while (uptime() < t0 + BENCHTICKS) {
+        c = 1;
+        write(ping[1], &c, 1);
+        read(pong[0], &c, 1);
+        n++;
+    }
+    c = 0;
+    write(ping[1], &c, 1);
+    wait(0);
+    setaffinity(getpid(), pmask | cmask);
+
+    printf("%s: %d round trips/s, %d us each\n", what,
+           n * 10 / BENCHTICKS, n ? BENCHTICKS * 100000 / n : 0);
+    close(ping[0]);
+    close(ping[1]);
+    close(pong[0]);
+    close(pong[1]);
+}
+
+int main(int argc, char *argv[]) {
     int pid = getpid();
 
+    // pingpong -b measures round trips instead.
+    if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+        bench("one cpu", 1, 1);
+        bench("two cpus", 1, 2);
+        exit(0);
+    }
+
     // array to store pipe fd
     int p[2];
     pipe(p);
@@ -30,4 +80,4 @@ int main() {
     write(1, buf, 4);
     write(1, "\n", 1);
     exit(0);
-}
\ No newline at end of file
+}
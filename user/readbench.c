@@ -0,0 +1,93 @@
+//
+// readers of one file: a process on each of 1, 2, ... ncpu cpus
+// opens the file, reads it through and closes it, as fast as it
+// can for a second. readers share the inode locks of the file and
+// the directories on its path, so the total should grow with the
+// number of cpus, until the buffer cache is the bottleneck.
+//   readbench [file [ncpu]]
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define BENCHTICKS 10
+
+char buf[512];
+
+// read path through as often as possible until tick end,
+// and return the number of bytes read.
+int
+reader(char *path, int end)
+{
+  int fd, n, total = 0;
+
+  while(uptime() < end){
+    if((fd = open(path, O_RDONLY)) < 0){
+      fprintf(2, "readbench: cannot open %s\n", path);
+      exit(1);
+    }
+    while((n = read(fd, buf, sizeof(buf))) > 0)
+      total += n;
+    close(fd);
+  }
+  return total;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fds[2], cpus[NCPU], ncpu = 0, max, i, n;
+  int start, total, one = 0, bytes;
+  char *path;
+
+  path = argc > 1 ? argv[1] : "README";
+  max = argc > 2 ? atoi(argv[2]) : NCPU;
+  for(i = 0; i < NCPU && ncpu < max; i++)
+    if(setaffinity(getpid(), 1 << i) == 0)
+      cpus[ncpu++] = i;  // only online cpus are accepted
+  setaffinity(getpid(), ALLCPUS);
+  if(ncpu == 0){
+    fprintf(2, "readbench: no cpus\n");
+    exit(1);
+  }
+
+  if(pipe(fds) < 0){
+    fprintf(2, "readbench: pipe failed\n");
+    exit(1);
+  }
+  for(n = 1; n <= ncpu; n++){
+    // everyone starts on the same tick boundary.
+    start = uptime() + 2;
+    for(i = 0; i < n; i++){
+      int pid = fork();
+      if(pid < 0){
+        fprintf(2, "readbench: fork failed\n");
+        exit(1);
+      }
+      if(pid == 0){
+        setaffinity(getpid(), 1 << cpus[i]);
+        while(uptime() < start)
+          ;
+        bytes = reader(path, start + BENCHTICKS);
+        write(fds[1], &bytes, sizeof(bytes));
+        exit(0);
+      }
+    }
+    total = 0;
+    for(i = 0; i < n; i++){
+      read(fds[0], &bytes, sizeof(bytes));
+      total += bytes;
+    }
+    for(i = 0; i < n; i++)
+      wait(0);
+    // KB/s, from bytes in BENCHTICKS tenths of a second.
+    total = total / 1024 * 10 / BENCHTICKS;
+    if(n == 1)
+      one = total;
+    printf("%d cpus: %d KB/s, %d%% of %d times one cpu\n",
+           n, total, one ? total * 100 / (one * n) : 0, n);
+  }
+  exit(0);
+}
@@ -0,0 +1,172 @@
+//
+// test the earliest-deadline-first real-time class: setrt()
+// admission control, and deadline misses of periodic tasks
+// that share cpu 0 with cpu-bound ordinary processes.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define MS       1000000UL   // nanoseconds
+#define NRT      2           // periodic tasks
+#define NHOG     2           // ordinary spinners
+#define PERIOD   (20*MS)
+#define RUNTIME  (6*MS)
+#define NPERIOD  50
+#define MAXMISS  2           // allowed for emulator jitter
+
+void
+fail(char *msg)
+{
+  printf("rttest: %s\n", msg);
+  exit(1);
+}
+
+volatile uint64 sink;
+
+void
+work(uint64 n)
+{
+  for(uint64 i = 0; i < n; i++)
+    sink++;
+}
+
+// loop iterations that take about a millisecond, found by
+// spinning for a few ticks.
+uint64
+calibrate(void)
+{
+  uint64 n = 0;
+  int start, end;
+
+  start = uptime();
+  while(uptime() == start)
+    ;
+  end = start + 1 + 3;
+  while(uptime() < end){
+    work(1000);
+    n += 1000;
+  }
+  return n / (3 * 100);
+}
+
+// run NPERIOD periods of work ms each as a real-time task
+// with the given budget, and return the number of misses.
+int
+periodic(uint64 budget, uint64 ms, uint64 loops)
+{
+  int misses = 0, r;
+
+  if(setrt(getpid(), budget, PERIOD, PERIOD) < 0)
+    fail("setrt of a periodic task failed");
+  for(int i = 0; i < NPERIOD; i++){
+    work(ms * loops);
+    if((r = rtyield()) < 0)
+      fail("rtyield failed");
+    misses += r;
+  }
+  return misses;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pids[NHOG], fds[2], pid, i, n, status;
+  uint64 loops;
+
+  if(rtyield() != -1)
+    fail("rtyield of an ordinary process succeeded");
+  if(setrt(getpid(), 2*MS, MS, 2*MS) != -1)
+    fail("runtime beyond the deadline accepted");
+  if(setrt(getpid(), MS, 3*MS, 2*MS) != -1)
+    fail("deadline beyond the period accepted");
+  if(setrt(-1, MS, MS, 2*MS) != -1)
+    fail("setrt of a bad pid succeeded");
+
+  // everything below shares cpu 0; children inherit the mask.
+  if(setaffinity(getpid(), 1) < 0)
+    fail("setaffinity failed");
+  loops = calibrate();
+
+  // admission control: 60% fits, another 40% does not, and
+  // 30% does. giving up the 60% makes room again.
+  if(setrt(getpid(), 60*MS, 100*MS, 100*MS) < 0)
+    fail("60% not admitted");
+  if(setaffinity(getpid(), 2) != -1)
+    fail("real-time process moved off its cpu");
+  pid = fork();
+  if(pid < 0)
+    fail("fork failed");
+  if(pid == 0){
+    if(rtyield() != -1)
+      exit(1);  // a child must not inherit the class
+    if(setrt(getpid(), 40*MS, 100*MS, 100*MS) != -1)
+      exit(2);
+    if(setrt(getpid(), 30*MS, 100*MS, 100*MS) < 0)
+      exit(3);
+    exit(0);
+  }
+  wait(&status);
+  if(status != 0)
+    fail("admission control is wrong");
+  if(setrt(getpid(), 0, 0, 0) < 0)
+    fail("could not leave the real-time class");
+  if(setrt(getpid(), 90*MS, 100*MS, 100*MS) < 0)
+    fail("share of an exited process not given back");
+  if(setrt(getpid(), 0, 0, 0) < 0)
+    fail("could not leave the real-time class");
+
+  // ordinary processes that would take all of cpu 0.
+  for(i = 0; i < NHOG; i++){
+    if((pids[i] = fork()) < 0)
+      fail("fork failed");
+    if(pids[i] == 0)
+      for(;;)
+        work(1000000);
+  }
+
+  // periodic tasks that use half their budget must meet
+  // every deadline despite the spinners.
+  if(pipe(fds) < 0)
+    fail("pipe failed");
+  for(i = 0; i < NRT; i++){
+    if((pid = fork()) < 0)
+      fail("fork failed");
+    if(pid == 0){
+      n = periodic(RUNTIME, RUNTIME / MS / 2, loops);
+      write(fds[1], &n, sizeof(n));
+      exit(0);
+    }
+  }
+  for(i = 0; i < NRT; i++){
+    read(fds[0], &n, sizeof(n));
+    printf("periodic task: %d of %d deadlines missed\n", n, NPERIOD);
+    if(n > MAXMISS)
+      fail("periodic task missed deadlines");
+  }
+  for(i = 0; i < NRT; i++)
+    wait(0);
+
+  // one that overruns its budget is throttled, and misses.
+  pid = fork();
+  if(pid < 0)
+    fail("fork failed");
+  if(pid == 0){
+    n = periodic(2*MS, 4, loops);
+    write(fds[1], &n, sizeof(n));
+    exit(0);
+  }
+  read(fds[0], &n, sizeof(n));
+  wait(0);
+  printf("overrunning task: %d of %d deadlines missed\n", n, NPERIOD);
+  if(n < NPERIOD / 2)
+    fail("overrunning task was not throttled");
+
+  for(i = 0; i < NHOG; i++){
+    kill(pids[i]);
+    wait(0);
+  }
+  printf("rttest: OK\n");
+  exit(0);
+}
@@ -0,0 +1,191 @@
+//
+// test signals and interval timers: handlers, masks, default
+// actions, interrupted sleeps and setitimer() precision.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/signal.h"
+#include "user/user.h"
+
+void
+fail(char *msg)
+{
+  printf("sigtest: %s\n", msg);
+  exit(1);
+}
+
+volatile int got[NSIG];
+volatile int lastsig;
+
+void
+handler(int sig)
+{
+  got[sig]++;
+  lastsig = sig;
+  sigreturn();
+}
+
+void
+spin(void)
+{
+  volatile int n = 0;
+
+  for(int i = 0; i < 1000000; i++)
+    n++;
+}
+
+// handlers run with the signal number, after the system call
+// that sent the signal returns.
+void
+handlertest(void)
+{
+  if(sigaction(SIGUSR1, handler) < 0 || sigaction(SIGUSR2, handler) < 0)
+    fail("sigaction failed");
+  if(sigaction(SIGKILL, handler) != -1)
+    fail("SIGKILL handler accepted");
+  if(sigaction(NSIG, handler) != -1)
+    fail("bad signal accepted");
+  if(sigsend(getpid(), SIGUSR1) < 0)
+    fail("sigsend failed");
+  if(got[SIGUSR1] != 1 || lastsig != SIGUSR1)
+    fail("handler not called with its signal");
+  if(sigsend(getpid(), SIGUSR2) < 0 || got[SIGUSR2] != 1)
+    fail("second signal not delivered");
+  if(sigsend(-1, SIGUSR1) != -1)
+    fail("sigsend to a bad pid succeeded");
+}
+
+// a blocked signal waits until it is unblocked; an ignored
+// one is dropped.
+void
+masktest(void)
+{
+  int old;
+
+  got[SIGUSR1] = 0;
+  old = sigprocmask(SIG_BLOCK, SIGBIT(SIGUSR1));
+  if(old != 0)
+    fail("mask not empty");
+  sigsend(getpid(), SIGUSR1);
+  sigsend(getpid(), SIGUSR1);
+  if(got[SIGUSR1] != 0)
+    fail("blocked signal delivered");
+  sigprocmask(SIG_UNBLOCK, SIGBIT(SIGUSR1));
+  if(got[SIGUSR1] != 1)
+    fail("unblocked signal not delivered once");
+  if(sigprocmask(SIG_SETMASK, 0) != 0)
+    fail("mask not restored");
+
+  sigaction(SIGUSR1, (void (*)(int))SIG_IGN);
+  sigsend(getpid(), SIGUSR1);
+  if(got[SIGUSR1] != 1)
+    fail("ignored signal delivered");
+  sigaction(SIGUSR1, handler);
+}
+
+// SIGTERM kills by default; SIGCHLD is ignored by default,
+// and caught when a handler is set.
+void
+defaulttest(void)
+{
+  int pid, status, fds[2];
+
+  if(pipe(fds) < 0)
+    fail("pipe failed");
+  got[SIGCHLD] = 0;
+  sigaction(SIGCHLD, handler);
+  pid = fork();
+  if(pid < 0)
+    fail("fork failed");
+  if(pid == 0){
+    char c;
+    close(fds[1]);
+    read(fds[0], &c, 1);  // never returns; the write end stays open
+    exit(0);
+  }
+  close(fds[0]);
+  sleep(1);
+  if(sigsend(pid, SIGTERM) < 0)
+    fail("sigsend failed");
+  // a wait() may be interrupted by the SIGCHLD.
+  while(wait(&status) != pid)
+    ;
+  if(status != -1)
+    fail("SIGTERM did not kill");
+  if(got[SIGCHLD] != 1)
+    fail("no SIGCHLD");
+  sigaction(SIGCHLD, (void (*)(int))SIG_DFL);
+  close(fds[1]);
+}
+
+// a signal ends a sleep in a system call, which fails.
+void
+interrupttest(void)
+{
+  int fds[2], t0, t1;
+  char c;
+
+  if(pipe(fds) < 0)
+    fail("pipe failed");
+  got[SIGALRM] = 0;
+  sigaction(SIGALRM, handler);
+
+  if(setitimer(50000, 0) < 0)
+    fail("setitimer failed");
+  if(read(fds[0], &c, 1) != -1)
+    fail("read not interrupted");
+  if(got[SIGALRM] != 1)
+    fail("no SIGALRM in read");
+
+  t0 = uptime();
+  setitimer(30000, 0);
+  if(sleep(50) != -1)
+    fail("sleep not interrupted");
+  t1 = uptime();
+  if(t1 - t0 > 5)
+    fail("sleep interrupted late");
+  if(got[SIGALRM] != 2)
+    fail("no SIGALRM in sleep");
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// a periodic 1ms timer, counted over a second of spinning.
+void
+periodictest(void)
+{
+  int t0, n;
+
+  got[SIGALRM] = 0;
+  if(setitimer(1, 50) != -1)
+    fail("period under the minimum accepted");
+  t0 = uptime();
+  while(uptime() == t0)
+    ;
+  if(setitimer(1000, 1000) < 0)
+    fail("setitimer failed");
+  while(uptime() < t0 + 11)
+    spin();
+  setitimer(0, 0);
+  n = got[SIGALRM];
+  printf("periodic 1ms timer: %d signals in 1s\n", n);
+  if(n < 500 || n > 1100)
+    fail("periodic timer is imprecise");
+  n = got[SIGALRM];
+  sleep(2);
+  if(got[SIGALRM] != n)
+    fail("stopped timer still fires");
+}
+
+int
+main(int argc, char *argv[])
+{
+  handlertest();
+  masktest();
+  defaulttest();
+  interrupttest();
+  periodictest();
+  printf("sigtest: OK\n");
+  exit(0);
+}
@@ -0,0 +1,104 @@
+//
+// test that nanosleep() and sleep() wake up on time.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define NSLEEP 200
+#define SHORT  500000ULL   // 500us in nanoseconds
+
+// many short sleeps must not each be rounded up to a tick.
+void
+short_sleeps(void)
+{
+  int t0, t1;
+
+  printf("short sleeps: ");
+  t0 = uptime();
+  for(int i = 0; i < NSLEEP; i++){
+    if(nanosleep(SHORT) < 0){
+      printf("nanosleep failed\n");
+      exit(1);
+    }
+  }
+  t1 = uptime();
+  // NSLEEP * SHORT is 100ms, one tick; allow plenty of slack.
+  if(t1 - t0 > 5){
+    printf("took %d ticks, expected about 1\n", t1 - t0);
+    exit(1);
+  }
+  printf("OK\n");
+}
+
+// sleep() must not return early.
+void
+tick_sleep(void)
+{
+  int t0, t1;
+
+  printf("tick sleep: ");
+  t0 = uptime();
+  sleep(3);
+  t1 = uptime();
+  if(t1 - t0 < 3){
+    printf("slept %d ticks, expected 3\n", t1 - t0);
+    exit(1);
+  }
+  printf("OK\n");
+}
+
+// sleepers with different deadlines must wake in deadline order.
+void
+ordering(void)
+{
+  int fds[2], pid, i, order[3];
+
+  printf("ordering: ");
+  if(pipe(fds) < 0){
+    printf("pipe failed\n");
+    exit(1);
+  }
+  // started longest first, so a sleeper that woke with
+  // the first expiry would show up out of order.
+  for(i = 2; i >= 0; i--){
+    pid = fork();
+    if(pid < 0){
+      printf("fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      nanosleep((uint64)(i+1) * 50000000ULL);
+      write(fds[1], &i, sizeof(i));
+      exit(0);
+    }
+  }
+  close(fds[1]);
+  for(i = 0; i < 3; i++){
+    if(read(fds[0], &order[i], sizeof(int)) != sizeof(int)){
+      printf("read failed\n");
+      exit(1);
+    }
+  }
+  close(fds[0]);
+  for(i = 0; i < 3; i++)
+    wait(0);
+  for(i = 0; i < 3; i++){
+    if(order[i] != i){
+      printf("sleeper %d woke %dth\n", order[i], i);
+      exit(1);
+    }
+  }
+  printf("OK\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  short_sleeps();
+  tick_sleep();
+  ordering();
+  printf("sleeptest: all tests passed\n");
+  exit(0);
+}
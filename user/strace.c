@@ -0,0 +1,169 @@
+//
+// trace the system calls a command, and the children it forks,
+// make, and print a line for each as it returns:
+//   pid  cpu  +start  name(a0, a1, a2) = result  <duration>
+// with times in microseconds from when strace started. -e names
+// the calls to trace, separated by commas; the default is all.
+// calls that never return, like exit, don't show up.
+//   strace [-e call,...] command [arg ...]
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/riscv.h"
+#include "kernel/signal.h"
+#include "kernel/syscall.h"
+#include "kernel/sysnames.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+#define NREAD 64
+#define NNAMES (sizeof(syscalls_names) / sizeof(syscalls_names[0]))
+
+struct traceevent buf[NREAD];
+uint64 start;
+volatile int done;
+
+void
+onchild(int sig)
+{
+  done = 1;
+  sigreturn();
+}
+
+uint64
+us(uint64 cycles)
+{
+  return cycles / (TIMEBASE / 1000000);
+}
+
+// print a as a number if it looks like one, else as an address.
+void
+printarg(uint64 a)
+{
+  if(a < 100000 || -a < 100000)
+    printf("%ld", a);
+  else
+    printf("0x%lx", a);
+}
+
+void
+print(struct traceevent *e)
+{
+  char *name = "?";
+
+  if(e->num > 0 && e->num < NNAMES && syscalls_names[e->num])
+    name = syscalls_names[e->num];
+  printf("%d\tcpu%d\t+%lu\t%s(", e->pid, e->cpu, us(e->time - start), name);
+  // no call takes more than three arguments but setrt.
+  for(int i = 0; i < 3; i++){
+    if(i > 0)
+      printf(", ");
+    printarg(e->args[i]);
+  }
+  printf(") = ");
+  printarg(e->retval);
+  printf("\t<%lu>\n", us(e->duration));
+}
+
+// print the events the rings hold, each read's worth in the
+// order the calls were made.
+void
+drain(void)
+{
+  struct traceevent e;
+  int n, i, j;
+
+  while((n = traceread(buf, NREAD)) > 0){
+    for(i = 1; i < n; i++){
+      e = buf[i];
+      for(j = i; j > 0 && buf[j-1].time > e.time; j--)
+        buf[j] = buf[j-1];
+      buf[j] = e;
+    }
+    for(i = 0; i < n; i++)
+      print(&buf[i]);
+  }
+}
+
+// the mask of the calls named in list, or 0 if one is unknown.
+uint64
+parsemask(char *list)
+{
+  uint64 mask = 0;
+  char *p, *q;
+  int i, n;
+
+  for(p = list; *p; p = *q ? q + 1 : q){
+    for(q = p; *q && *q != ','; q++)
+      ;
+    n = q - p;
+    for(i = 1; i < NNAMES; i++)
+      if(syscalls_names[i] && strlen(syscalls_names[i]) == n &&
+         memcmp(syscalls_names[i], p, n) == 0)
+        break;
+    if(i == NNAMES)
+      return 0;
+    mask |= 1UL << i;
+  }
+  return mask;
+}
+
+void
+usage(void)
+{
+  fprintf(2, "usage: strace [-e call,...] command [arg ...]\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 mask = ~0UL;
+  int i, pid, dropped;
+
+  for(i = 1; i < argc && argv[i][0] == '-'; i++){
+    if(strcmp(argv[i], "-e") == 0 && i + 1 < argc){
+      if((mask = parsemask(argv[++i])) == 0){
+        fprintf(2, "strace: unknown call in %s\n", argv[i]);
+        exit(1);
+      }
+    } else
+      usage();
+  }
+  if(i == argc)
+    usage();
+
+  // events left from an earlier run would confuse this one.
+  trace(0);
+  while(traceread(buf, NREAD) > 0)
+    ;
+
+  sigaction(SIGCHLD, onchild);
+  start = r_time();
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "strace: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    trace(mask);
+    exec(argv[i], argv + i);
+    fprintf(2, "strace: exec %s failed\n", argv[i]);
+    exit(1);
+  }
+
+  // the rings hold 256 calls per cpu; empty them every
+  // tick until the command exits.
+  while(!done){
+    sleep(1);
+    drain();
+  }
+  dropped = trace(0);
+  drain();
+  wait(0);
+
+  if(dropped)
+    printf("strace: %d calls dropped\n", dropped);
+  exit(0);
+}
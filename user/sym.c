@@ -0,0 +1,122 @@
+// Symbol tables, from the .sym files that the Makefile makes
+// with objdump -t: a line per symbol, with its address in hex
+// and its name.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+static uint64
+hex(char **sp)
+{
+  uint64 x = 0;
+  char *s = *sp;
+
+  for(;; s++){
+    if(*s >= '0' && *s <= '9')
+      x = x*16 + *s - '0';
+    else if(*s >= 'a' && *s <= 'f')
+      x = x*16 + *s - 'a' + 10;
+    else
+      break;
+  }
+  *sp = s;
+  return x;
+}
+
+// objdump also lists sections (.text), source files (ls.c)
+// and mapping symbols ($x), none of which name code.
+static int
+iscode(char *name)
+{
+  int n = strlen(name);
+
+  if(name[0] == '.' || name[0] == '$' || name[0] == 0)
+    return 0;
+  if(n > 2 && name[n-2] == '.' && (name[n-1] == 'c' || name[n-1] == 'S'))
+    return 0;
+  return 1;
+}
+
+// Load the symbols in path into t, sorted by address.
+// Returns -1 if path can't be read.
+int
+symload(struct symtab *t, char *path)
+{
+  struct stat st;
+  char *buf, *s, *name;
+  uint64 a;
+  int fd, n, i, j;
+
+  if((fd = open(path, O_RDONLY)) < 0)
+    return -1;
+  if(fstat(fd, &st) < 0 || (buf = malloc(st.size + 1)) == 0){
+    close(fd);
+    return -1;
+  }
+  for(i = 0; i < st.size; i += n)
+    if((n = read(fd, buf + i, st.size - i)) <= 0)
+      break;
+  close(fd);
+  buf[i] = 0;
+
+  n = 0;
+  for(s = buf; *s; s++)
+    if(*s == '\n')
+      n++;
+  t->addr = malloc((n + 1) * sizeof(uint64));
+  t->name = malloc((n + 1) * sizeof(char*));
+  if(t->addr == 0 || t->name == 0)
+    return -1;
+
+  // parse the lines in place, inserting each in order.
+  t->n = 0;
+  for(s = buf; *s; ){
+    a = hex(&s);
+    while(*s == ' ')
+      s++;
+    name = s;
+    while(*s && *s != '\n')
+      s++;
+    if(*s)
+      *s++ = 0;
+    if(!iscode(name))
+      continue;
+    for(j = t->n; j > 0 && t->addr[j-1] > a; j--){
+      t->addr[j] = t->addr[j-1];
+      t->name[j] = t->name[j-1];
+    }
+    t->addr[j] = a;
+    t->name[j] = name;
+    t->n++;
+  }
+  return 0;
+}
+
+// The index in t of the symbol for the code at pc: the one
+// with the highest address at or below it. Returns -1 if pc
+// is below every symbol.
+int
+symindex(struct symtab *t, uint64 pc)
+{
+  int lo = 0, hi = t->n;
+
+  // invariant: addr[lo-1] <= pc < addr[hi].
+  while(lo < hi){
+    int mid = (lo + hi) / 2;
+    if(t->addr[mid] <= pc)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo - 1;
+}
+
+char*
+symname(struct symtab *t, uint64 pc)
+{
+  int i = symindex(t, pc);
+
+  return i < 0 ? "?" : t->name[i];
+}
@@ -0,0 +1,183 @@
+//
+// test clone()/join() threads and the uthread library.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define NTHR   8
+#define NELEM  (64*1024)
+
+int data[NELEM];
+uint64 sums[NTHR];
+
+void
+fail(char *msg)
+{
+  printf("threadtest: %s\n", msg);
+  exit(1);
+}
+
+int
+sumslice(void *arg)
+{
+  int i = (int)(uint64)arg;
+  uint64 s = 0;
+
+  for(int j = i * (NELEM/NTHR); j < (i+1) * (NELEM/NTHR); j++)
+    s += data[j];
+  sums[i] = s;
+  return i;
+}
+
+// NTHR threads each sum a slice of one array.
+void
+parallelsum(void)
+{
+  int tids[NTHR], status;
+  uint64 want = 0, got = 0;
+
+  printf("parallel sum: ");
+  for(int i = 0; i < NELEM; i++){
+    data[i] = i;
+    want += i;
+  }
+  for(int i = 0; i < NTHR; i++){
+    if((tids[i] = thread_create(sumslice, (void*)(uint64)i)) < 0)
+      fail("thread_create failed");
+  }
+  for(int i = 0; i < NTHR; i++){
+    if(thread_join(tids[i], &status) != tids[i])
+      fail("thread_join failed");
+    if(status != i)
+      fail("wrong exit status");
+    got += sums[i];
+  }
+  if(got != want)
+    fail("wrong sum");
+  printf("OK\n");
+}
+
+int fds[2];
+char *grown;
+
+int
+openpipe(void *arg)
+{
+  if(pipe(fds) < 0)
+    return 1;
+  grown = sbrk(4096);
+  if(grown == (char*)-1)
+    return 1;
+  grown[0] = 'x';
+  return 0;
+}
+
+// a thread's new file descriptors and memory are
+// the whole process's.
+void
+sharing(void)
+{
+  int tid, status;
+  char c = 'y';
+
+  printf("shared files and memory: ");
+  if((tid = thread_create(openpipe, 0)) < 0)
+    fail("thread_create failed");
+  if(thread_join(tid, &status) < 0 || status != 0)
+    fail("thread failed");
+  if(grown[0] != 'x')
+    fail("sbrk() in a thread is not visible");
+  if(write(fds[1], &c, 1) != 1 || read(fds[0], &c, 1) != 1 || c != 'y')
+    fail("pipe from a thread is not usable");
+  close(fds[0]);
+  close(fds[1]);
+  printf("OK\n");
+}
+
+volatile int stop;
+
+int
+spinner(void *arg)
+{
+  while(!stop)
+    ;
+  return 0;
+}
+
+// wait() reaps forked children, not threads, and
+// join() the reverse.
+void
+reaping(void)
+{
+  int tid, pid;
+
+  printf("wait and join: ");
+  stop = 0;
+  if((tid = thread_create(spinner, 0)) < 0)
+    fail("thread_create failed");
+  if((pid = fork()) < 0)
+    fail("fork failed");
+  if(pid == 0)
+    exit(0);
+  if(wait(0) != pid)
+    fail("wait did not return the forked child");
+  if(join(pid, 0) != -1)
+    fail("join returned a forked child");
+  stop = 1;
+  if(thread_join(tid, 0) != tid)
+    fail("thread_join failed");
+  if(wait(0) != -1)
+    fail("wait found a child that should not be there");
+  printf("OK\n");
+}
+
+int
+writer(void *arg)
+{
+  for(;;)
+    write(fds[1], "w", 1);
+}
+
+// when a process's first thread exits, its other threads
+// do too: once they have, the pipe they write to has no
+// writers left, and reading it finds end of file.
+void
+exitall(void)
+{
+  int pid;
+  char buf[64];
+
+  printf("exit ends all threads: ");
+  if(pipe(fds) < 0)
+    fail("pipe failed");
+  if((pid = fork()) < 0)
+    fail("fork failed");
+  if(pid == 0){
+    close(fds[0]);
+    for(int i = 0; i < 3; i++)
+      if(thread_create(writer, 0) < 0)
+        exit(1);
+    sleep(1);
+    exit(0);
+  }
+  close(fds[1]);
+  while(read(fds[0], buf, sizeof(buf)) > 0)
+    ;
+  close(fds[0]);
+  wait(0);
+  printf("OK\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  parallelsum();
+  sharing();
+  reaping();
+  exitall();
+  printf("threadtest: all tests passed\n");
+  exit(0);
+}
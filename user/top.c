@@ -0,0 +1,102 @@
+//
+// show what the processes are doing with the cpus.
+//   top [rounds]
+// each round takes two snapshots of every process's scheduler
+// statistics a second apart, and prints the load averages and,
+// busiest first, each process's share of a cpu over that second,
+// its total user, system and runnable-wait time in milliseconds,
+// its voluntary and involuntary context switches, and the cpu
+// it last ran on.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/schedstat.h"
+#include "user/user.h"
+
+#define MAXPROC  256
+#define INTERVAL 10    // ticks between snapshots
+#define CYCPERMS (TIMEBASE / 1000)
+
+struct schedstat before[MAXPROC], after[MAXPROC];
+long busy[MAXPROC];     // cycles each proc in after[] ran for in the round
+
+// enum procstate in kernel/proc.h
+char *states[] = { "unused", "used", "sleep", "runble", "run", "zombie" };
+
+// the cycles that st ran for since the snapshot in before[].
+long
+delta(struct schedstat *st, int nbefore)
+{
+  for(int i = 0; i < nbefore; i++){
+    if(before[i].pid == st->pid)
+      return (st->utime + st->stime) - (before[i].utime + before[i].stime);
+  }
+  return st->utime + st->stime;
+}
+
+void
+showround(void)
+{
+  int nbefore, nafter, t0, t1, avg[3], i, j, best, pct;
+  uint64 elapsed;
+
+  t0 = uptime();
+  if((nbefore = schedstat(0, before, MAXPROC)) < 0){
+    printf("top: schedstat failed\n");
+    exit(1);
+  }
+  sleep(INTERVAL);
+  t1 = uptime();
+  if((nafter = schedstat(0, after, MAXPROC)) < 0 || loadavg(avg) < 0){
+    printf("top: schedstat failed\n");
+    exit(1);
+  }
+  elapsed = (uint64)(t1 - t0) * TICKCYCLES;
+  if(elapsed == 0)
+    elapsed = 1;
+
+  printf("\nload average: %d.%d%d, %d.%d%d, %d.%d%d   %d procs\n",
+         avg[0] / 100, avg[0] / 10 % 10, avg[0] % 10,
+         avg[1] / 100, avg[1] / 10 % 10, avg[1] % 10,
+         avg[2] / 100, avg[2] / 10 % 10, avg[2] % 10, nafter);
+  printf("pid\tstate\t%%cpu\tuser\tsys\twait\tvcsw\tivcsw\tcpu\tname\n");
+
+  for(i = 0; i < nafter; i++)
+    busy[i] = delta(&after[i], nbefore);
+
+  // print the busiest remaining proc each time around.
+  for(j = 0; j < nafter; j++){
+    best = -1;
+    for(i = 0; i < nafter; i++){
+      if(busy[i] >= 0 && (best < 0 || busy[i] > busy[best]))
+        best = i;
+    }
+    struct schedstat *st = &after[best];
+    pct = busy[best] * 1000 / elapsed;  // tenths of a percent
+    busy[best] = -1;
+    printf("%d\t%s\t%d.%d\t%lu\t%lu\t%lu\t%d\t%d\t%d\t%s\n",
+           st->pid, st->state >= 0 && st->state < 6 ? states[st->state] : "???",
+           pct / 10, pct % 10,
+           st->utime / CYCPERMS, st->stime / CYCPERMS, st->wtime / CYCPERMS,
+           st->nvcsw, st->nivcsw, st->cpu, st->name);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rounds = 1;
+
+  if(argc > 2){
+    fprintf(2, "usage: top [rounds]\n");
+    exit(1);
+  }
+  if(argc == 2 && (rounds = atoi(argv[1])) < 1){
+    fprintf(2, "top: bad round count %s\n", argv[1]);
+    exit(1);
+  }
+  while(rounds-- > 0)
+    showround();
+  exit(0);
+}
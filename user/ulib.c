@@ -155,3 +155,74 @@ ugetpid(void)
   struct usyscall *u = (struct usyscall *)USYSCALL;
   return u->pid;
 }
+
+// Read a field of the usyscall page that the kernel may be
+// changing, retrying until the read didn't overlap a change.
+static int
+usysread(int *field)
+{
+  struct usyscall *u = (struct usyscall *)USYSCALL;
+  uint seq;
+  int x;
+
+  do{
+    while((seq = __atomic_load_n(&u->seq, __ATOMIC_ACQUIRE)) & 1)
+      ;
+    x = __atomic_load_n(field, __ATOMIC_RELAXED);
+    __sync_synchronize();
+  } while(__atomic_load_n(&u->seq, __ATOMIC_RELAXED) != seq);
+  return x;
+}
+
+// the parent's pid, without a trap. 0 for init.
+int
+ugetppid(void)
+{
+  return usysread(&((struct usyscall *)USYSCALL)->ppid);
+}
+
+// the cpu this process last entered user space on. in a
+// process with threads, the first thread's cpu.
+int
+ugetcpu(void)
+{
+  return usysread(&((struct usyscall *)USYSCALL)->cpu);
+}
+
+// faster uptime system call: ticks since boot, from the clock.
+int
+uuptime(void)
+{
+  struct usyscall *u = (struct usyscall *)USYSCALL;
+  return (r_time() - u->tickbase) / u->tickcycles;
+}
+
+// the time since boot (CLOCK_MONOTONIC), or since this
+// process was created (CLOCK_PROCESS), without a trap.
+int
+clock_gettime(int clock, struct timespec *ts)
+{
+  struct usyscall *u = (struct usyscall *)USYSCALL;
+  uint64 t = r_time();
+
+  if(clock == CLOCK_MONOTONIC)
+    t -= u->tickbase;
+  else if(clock == CLOCK_PROCESS)
+    t -= u->starttime;
+  else
+    return -1;
+  ts->tv_sec = t / u->timebase;
+  ts->tv_nsec = (t % u->timebase) * 1000000000 / u->timebase;
+  return 0;
+}
+
+// a fixed limit on this process, by RLIMIT_*, or -1.
+long
+getrlimit(int resource)
+{
+  struct usyscall *u = (struct usyscall *)USYSCALL;
+
+  if(resource < 0 || resource >= NRLIMIT)
+    return -1;
+  return u->rlimit[resource];
+}
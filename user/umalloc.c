@@ -21,8 +21,25 @@ typedef union header Header;
 static Header base;
 static Header *freep;
 
-void
-free(void *ap)
+// threads made by clone() share the free list.
+static volatile int lock;
+
+static void
+acquire(void)
+{
+  while(__sync_lock_test_and_set(&lock, 1) != 0)
+    ;
+}
+
+static void
+release(void)
+{
+  __sync_lock_release(&lock);
+}
+
+// caller holds lock.
+static void
+freelocked(void *ap)
 {
   Header *bp, *p;
 
@@ -43,6 +60,14 @@ free(void *ap)
   freep = p;
 }
 
+void
+free(void *ap)
+{
+  acquire();
+  freelocked(ap);
+  release();
+}
+
 static Header*
 morecore(uint nu)
 {
@@ -56,7 +81,7 @@ morecore(uint nu)
     return 0;
   hp = (Header*)p;
   hp->s.size = nu;
-  free((void*)(hp + 1));
+  freelocked((void*)(hp + 1));
   return freep;
 }
 
@@ -67,6 +92,7 @@ malloc(uint nbytes)
   uint nunits;
 
   nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
+  acquire();
   if((prevp = freep) == 0){
     base.s.ptr = freep = prevp = &base;
     base.s.size = 0;
@@ -81,10 +107,13 @@ malloc(uint nbytes)
         p->s.size = nunits;
       }
       freep = prevp;
+      release();
       return (void*)(p + 1);
     }
     if(p == freep)
-      if((p = morecore(nunits)) == 0)
+      if((p = morecore(nunits)) == 0){
+        release();
         return 0;
+      }
   }
 }
@@ -0,0 +1,153 @@
+//
+// profile a command in user space, and report the functions
+// in which its user pc was most often found.
+//   uprof [-r hz] command [arg ...]
+// the command's symbols come from command.sym, which the
+// Makefile makes along with each program.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/signal.h"
+#include "user/user.h"
+
+#define NTOP 25
+
+struct symtab syms;
+uint counts[NUPROF];
+int shift = 2;            // bytes per bucket, as a power of two
+volatile int done;
+
+void
+onchild(int sig)
+{
+  done = 1;
+  sigreturn();
+}
+
+void
+report(void)
+{
+  int *self, nsample = 0, nunknown = 0, i, j, best;
+
+  for(i = 0; i < NUPROF; i++)
+    nsample += counts[i];
+  printf("uprof: %d samples\n", nsample);
+  if(nsample == 0)
+    return;
+
+  if(syms.n == 0){
+    // no symbols: report the busiest buckets.
+    printf("self\tself%%\taddress\n");
+    for(j = 0; j < NTOP; j++){
+      best = 0;
+      for(i = 1; i < NUPROF; i++)
+        if(counts[i] > counts[best])
+          best = i;
+      if(counts[best] == 0)
+        break;
+      printf("%d\t%d%%\t0x%lx\n", counts[best], counts[best] * 100 / nsample,
+             (uint64)best << shift);
+      counts[best] = 0;
+    }
+    return;
+  }
+
+  self = malloc(syms.n * sizeof(int));
+  memset(self, 0, syms.n * sizeof(int));
+  for(i = 0; i < NUPROF; i++){
+    if(counts[i] == 0)
+      continue;
+    j = symindex(&syms, (uint64)i << shift);
+    if(j < 0)
+      nunknown += counts[i];
+    else
+      self[j] += counts[i];
+  }
+  printf("self\tself%%\tfunction\n");
+  for(j = 0; j < NTOP; j++){
+    best = -1;
+    for(i = 0; i < syms.n; i++)
+      if(self[i] > 0 && (best < 0 || self[i] > self[best]))
+        best = i;
+    if(best < 0)
+      break;
+    printf("%d\t%d%%\t%s\n", self[best], self[best] * 100 / nsample,
+           syms.name[best]);
+    self[best] = 0;
+  }
+  if(nunknown)
+    printf("%d\t%d%%\t?\n", nunknown, nunknown * 100 / nsample);
+}
+
+void
+usage(void)
+{
+  fprintf(2, "usage: uprof [-r hz] command [arg ...]\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char path[MAXPATH];
+  int hz = 1000, i, pid;
+
+  for(i = 1; i < argc && argv[i][0] == '-'; i++){
+    if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+      hz = atoi(argv[++i]);
+    else
+      usage();
+  }
+  if(i == argc)
+    usage();
+  if(hz <= 0 || hz > 10000){
+    fprintf(2, "uprof: bad rate %d\n", hz);
+    exit(1);
+  }
+
+  path[0] = 0;
+  if(strlen(argv[i]) + strlen(".sym") < sizeof(path)){
+    strcpy(path, argv[i]);
+    strcpy(path + strlen(path), ".sym");
+  }
+  if(path[0] == 0 || symload(&syms, path) < 0){
+    fprintf(2, "uprof: no symbols for %s\n", argv[i]);
+    syms.n = 0;
+  }
+  // buckets small enough to tell neighbouring functions apart,
+  // but enough of them to cover the whole program.
+  if(syms.n > 0)
+    while((syms.addr[syms.n-1] >> shift) >= NUPROF)
+      shift++;
+
+  sigaction(SIGCHLD, onchild);
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "uprof: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    // the counts are kept by the kernel, through exec.
+    if(uprof(shift, hz) < 0){
+      fprintf(2, "uprof: uprof failed\n");
+      exit(1);
+    }
+    exec(argv[i], argv + i);
+    fprintf(2, "uprof: exec %s failed\n", argv[i]);
+    exit(1);
+  }
+
+  // the counts go when the child is waited for, so fetch
+  // them as soon as it has exited.
+  while(!done)
+    sleep(1);
+  if(uprofread(pid, counts, NUPROF) < 0){
+    fprintf(2, "uprof: cannot read the counts\n");
+    wait(0);
+    exit(1);
+  }
+  wait(0);
+  report();
+  exit(0);
+}
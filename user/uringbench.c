@@ -0,0 +1,172 @@
+//
+// small i/o with and without a uring: write a file in many small
+// pieces and read it back, once with a write() or read() per
+// piece, once a batch of pieces per uring_enter(), and once more
+// writing with URING_ASYNC, so the uring's kernel thread does
+// the writing. each trap the batches save shows up per call.
+//   uringbench [ncalls]
+//
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/syscall.h"
+#include "kernel/uring.h"
+#include "user/user.h"
+
+#define SIZE  16   // bytes per call
+#define BATCH 32   // calls per uring_enter()
+
+char *file = "uringbench.tmp";
+char buf[SIZE];
+struct uring *ring;
+
+uint64
+nsnow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void
+report(char *name, uint64 t, int n)
+{
+  printf("%s\t%lu ns/call\n", name, t / n);
+}
+
+int
+openfile(int mode)
+{
+  int fd;
+
+  if((fd = open(file, mode)) < 0){
+    fprintf(2, "uringbench: cannot open %s\n", file);
+    exit(1);
+  }
+  return fd;
+}
+
+// check that the file holds n pieces.
+void
+checksize(int n)
+{
+  struct stat st;
+
+  if(stat(file, &st) < 0 || st.size != (uint64)n * SIZE){
+    fprintf(2, "uringbench: %s has the wrong size\n", file);
+    exit(1);
+  }
+}
+
+// Put a call on the submission ring.
+void
+submit(int op, int flags, uint64 a0, uint64 a1, uint64 a2, uint64 user_data)
+{
+  struct uring_sqe *sqe = &ring->sq[ring->sqtail % URING_ENTRIES];
+
+  sqe->op = op;
+  sqe->flags = flags;
+  sqe->args[0] = a0;
+  sqe->args[1] = a1;
+  sqe->args[2] = a2;
+  sqe->user_data = user_data;
+  __atomic_store_n(&ring->sqtail, ring->sqtail + 1, __ATOMIC_RELEASE);
+}
+
+// Take the completions that are ready, each of which should
+// have returned want, and return how many there were.
+int
+reap(uint64 want)
+{
+  struct uring_cqe *cqe;
+  int n = 0;
+
+  while(ring->cqhead != __atomic_load_n(&ring->cqtail, __ATOMIC_ACQUIRE)){
+    cqe = &ring->cq[ring->cqhead % URING_ENTRIES];
+    if(cqe->res != want){
+      fprintf(2, "uringbench: call %lu returned %ld\n", cqe->user_data, cqe->res);
+      exit(1);
+    }
+    __atomic_store_n(&ring->cqhead, ring->cqhead + 1, __ATOMIC_RELEASE);
+    n++;
+  }
+  return n;
+}
+
+// Make n calls of op on fd, BATCH at a time, and return
+// how long they took.
+uint64
+ringio(int op, int flags, int fd, int n)
+{
+  uint64 t = nsnow();
+  int i, j, k;
+
+  for(i = 0; i < n; i += k){
+    k = n - i < BATCH ? n - i : BATCH;
+    for(j = 0; j < k; j++)
+      submit(op, flags, fd, (uint64)buf, SIZE, i + j);
+    if(uring_enter(k, k) != k || reap(SIZE) != k){
+      fprintf(2, "uringbench: uring_enter failed\n");
+      exit(1);
+    }
+  }
+  return nsnow() - t;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n = argc > 1 ? atoi(argv[1]) : 2000;
+  int fd, i;
+  uint64 t;
+
+  if(n <= 0){
+    fprintf(2, "usage: uringbench [ncalls]\n");
+    exit(1);
+  }
+  if((ring = uring_setup()) == (struct uring*)-1){
+    fprintf(2, "uringbench: uring_setup failed\n");
+    exit(1);
+  }
+  memset(buf, 'u', sizeof(buf));
+  printf("%d calls of %d bytes each\n", n, SIZE);
+
+  fd = openfile(O_CREATE | O_TRUNC | O_WRONLY);
+  t = nsnow();
+  for(i = 0; i < n; i++)
+    if(write(fd, buf, SIZE) != SIZE){
+      fprintf(2, "uringbench: write failed\n");
+      exit(1);
+    }
+  report("write()", nsnow() - t, n);
+  close(fd);
+
+  fd = openfile(O_RDONLY);
+  t = nsnow();
+  for(i = 0; i < n; i++)
+    if(read(fd, buf, SIZE) != SIZE){
+      fprintf(2, "uringbench: read failed\n");
+      exit(1);
+    }
+  report("read()", nsnow() - t, n);
+  close(fd);
+
+  fd = openfile(O_CREATE | O_TRUNC | O_WRONLY);
+  report("uring write", ringio(SYS_write, 0, fd, n), n);
+  close(fd);
+  checksize(n);
+
+  fd = openfile(O_RDONLY);
+  report("uring read", ringio(SYS_read, 0, fd, n), n);
+  close(fd);
+
+  fd = openfile(O_CREATE | O_TRUNC | O_WRONLY);
+  report("async write", ringio(SYS_write, URING_ASYNC, fd, n), n);
+  close(fd);
+  checksize(n);
+
+  unlink(file);
+  exit(0);
+}
@@ -1,4 +1,18 @@
 struct stat;
+struct schedstat;
+struct kprofsample;
+struct lockstat;
+struct kstat;
+struct uring;
+struct traceevent;
+
+// clock_gettime()
+#define CLOCK_MONOTONIC 1  // time since boot
+#define CLOCK_PROCESS   2  // time since this process was created
+struct timespec {
+  uint64 tv_sec;
+  uint64 tv_nsec;
+};
 
 // system calls
 int fork(void);
@@ -22,10 +36,35 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
-int trace(int);
+int trace(uint64 mask);
 void kpgtbl(void);
 int sigalarm(int period, void (*handler)(void));
 int sigreturn(void);
+int setweight(int pid, int weight);
+int nanosleep(uint64 ns);
+int setaffinity(int pid, int mask);
+int getaffinity(int pid);
+int clone(void (*fn)(void*), void *arg, void *stack);
+int join(int pid, int *status);
+int futex_wait(int *addr, int val);
+int futex_wake(int *addr, int n);
+int schedstat(int pid, struct schedstat *st, int n);
+int loadavg(int *avg);
+int setrt(int pid, uint64 runtime, uint64 deadline, uint64 period);
+int rtyield(void);
+int sigaction(int sig, void (*handler)(int));
+int sigprocmask(int how, uint mask);
+int sigsend(int pid, int sig);
+int setitimer(uint64 value, uint64 interval);
+int kprofctl(int hz);
+int kprofread(struct kprofsample *buf, int n);
+int uprof(int shift, int hz);
+int uprofread(int pid, uint *buf, int n);
+int lockstat(struct lockstat *buf, int n, int clear);
+int kstat(struct kstat *buf, int n);
+struct uring* uring_setup(void);
+int uring_enter(int to_submit, int min_complete);
+int traceread(struct traceevent *buf, int n);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -42,7 +81,50 @@ int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
 int ugetpid(void);
+int ugetppid(void);
+int ugetcpu(void);
+int uuptime(void);
+int clock_gettime(int clock, struct timespec *ts);
+long getrlimit(int resource);
 
 // umalloc.c
 void* malloc(uint);
 void free(void*);
+
+// uthread.c
+int thread_create(int (*fn)(void*), void *arg);
+int thread_join(int tid, int *status);
+
+// usync.c
+struct mutex {
+  int state;
+};
+struct cond {
+  int seq;
+  int waiters;
+};
+struct sem {
+  int count;
+  int waiters;
+};
+void mutex_init(struct mutex*);
+void mutex_lock(struct mutex*);
+int mutex_trylock(struct mutex*);
+void mutex_unlock(struct mutex*);
+void cond_init(struct cond*);
+void cond_wait(struct cond*, struct mutex*);
+void cond_signal(struct cond*);
+void cond_broadcast(struct cond*);
+void sem_init(struct sem*, int);
+void sem_wait(struct sem*);
+void sem_post(struct sem*);
+
+// sym.c, linked only into the programs that need it
+struct symtab {
+  int n;
+  uint64 *addr;   // sorted
+  char **name;
+};
+int symload(struct symtab*, char*);
+int symindex(struct symtab*, uint64);
+char* symname(struct symtab*, uint64);
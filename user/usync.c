@@ -0,0 +1,135 @@
+// Mutexes, condition variables and semaphores for threads
+// sharing memory, on top of futex_wait() and futex_wake().
+//
+// Each keeps enough state in user memory that locking a
+// free mutex, unlocking one nobody waits for, signalling a
+// condition nobody waits on, and waiting on or posting a
+// semaphore that need not block make no system calls.
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define load(p)         __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define store(p, v)     __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define xchg(p, v)      __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define cas(p, old, v)  __sync_bool_compare_and_swap((p), (old), (v))
+
+// mutex states.
+#define UNLOCKED  0
+#define LOCKED    1   // and nobody is waiting
+#define CONTENDED 2   // and someone may be waiting
+
+void
+mutex_init(struct mutex *m)
+{
+  m->state = UNLOCKED;
+}
+
+// Take m, marking it CONTENDED: the caller may
+// not be the only one waiting for it.
+static void
+mutex_lock_contended(struct mutex *m)
+{
+  while(xchg(&m->state, CONTENDED) != UNLOCKED)
+    futex_wait(&m->state, CONTENDED);
+}
+
+void
+mutex_lock(struct mutex *m)
+{
+  if(cas(&m->state, UNLOCKED, LOCKED))
+    return;
+  mutex_lock_contended(m);
+}
+
+int
+mutex_trylock(struct mutex *m)
+{
+  return cas(&m->state, UNLOCKED, LOCKED) ? 0 : -1;
+}
+
+void
+mutex_unlock(struct mutex *m)
+{
+  if(xchg(&m->state, UNLOCKED) == CONTENDED)
+    futex_wake(&m->state, 1);
+}
+
+void
+cond_init(struct cond *c)
+{
+  c->seq = 0;
+  c->waiters = 0;
+}
+
+// Release m, wait for a signal, and take m again.
+// Like all condition variables, may wake spuriously.
+void
+cond_wait(struct cond *c, struct mutex *m)
+{
+  int seq = load(&c->seq);
+
+  __atomic_add_fetch(&c->waiters, 1, __ATOMIC_SEQ_CST);
+  mutex_unlock(m);
+  futex_wait(&c->seq, seq);
+  __atomic_sub_fetch(&c->waiters, 1, __ATOMIC_SEQ_CST);
+  // other waiters may have been woken onto m as well.
+  mutex_lock_contended(m);
+}
+
+// Wake one cond_wait()er. The caller must hold the
+// mutex the waiters use, so that none is between
+// checking its condition and counting itself a waiter.
+void
+cond_signal(struct cond *c)
+{
+  if(load(&c->waiters) == 0)
+    return;
+  __atomic_add_fetch(&c->seq, 1, __ATOMIC_SEQ_CST);
+  futex_wake(&c->seq, 1);
+}
+
+// Wake every cond_wait()er; the caller must hold the mutex.
+void
+cond_broadcast(struct cond *c)
+{
+  if(load(&c->waiters) == 0)
+    return;
+  __atomic_add_fetch(&c->seq, 1, __ATOMIC_SEQ_CST);
+  futex_wake(&c->seq, 0x7fffffff);
+}
+
+void
+sem_init(struct sem *s, int count)
+{
+  s->count = count;
+  s->waiters = 0;
+}
+
+void
+sem_wait(struct sem *s)
+{
+  int n;
+
+  for(;;){
+    n = load(&s->count);
+    if(n > 0){
+      if(cas(&s->count, n, n - 1))
+        return;
+      continue;
+    }
+    // a sem_post() that raced with us either sees us
+    // waiting or makes futex_wait() return at once.
+    __atomic_add_fetch(&s->waiters, 1, __ATOMIC_SEQ_CST);
+    futex_wait(&s->count, 0);
+    __atomic_sub_fetch(&s->waiters, 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+void
+sem_post(struct sem *s)
+{
+  __atomic_add_fetch(&s->count, 1, __ATOMIC_SEQ_CST);
+  if(load(&s->waiters) > 0)
+    futex_wake(&s->count, 1);
+}
@@ -40,3 +40,28 @@ entry("trace");
 entry("kpgtbl");
 entry("sigalarm");
 entry("sigreturn");
+entry("setweight");
+entry("nanosleep");
+entry("setaffinity");
+entry("getaffinity");
+entry("clone");
+entry("join");
+entry("futex_wait");
+entry("futex_wake");
+entry("schedstat");
+entry("loadavg");
+entry("setrt");
+entry("rtyield");
+entry("sigaction");
+entry("sigprocmask");
+entry("sigsend");
+entry("setitimer");
+entry("kprofctl");
+entry("kprofread");
+entry("uprof");
+entry("uprofread");
+entry("lockstat");
+entry("kstat");
+entry("uring_setup");
+entry("uring_enter");
+entry("traceread");
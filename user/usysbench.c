@@ -0,0 +1,86 @@
+//
+// the cost of a system call against reading the usyscall page:
+// time many calls of uptime() and getpid(), which trap, and of
+// uuptime() and ugetpid(), which don't, and check that they
+// agree, as do ugetppid() and clock_gettime().
+//   usysbench [ncalls]
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+uint64
+nsnow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void
+report(char *name, uint64 t, int n)
+{
+  printf("%s\t%lu ns/call\n", name, t / n);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n = argc > 1 ? atoi(argv[1]) : 100000;
+  int i, pid, ppid, up;
+  uint64 t;
+
+  if(n <= 0){
+    fprintf(2, "usage: usysbench [ncalls]\n");
+    exit(1);
+  }
+
+  // the two ways must agree.
+  up = uptime();
+  if(uuptime() < up || uuptime() > up + 1){
+    printf("usysbench: uuptime %d, uptime %d\n", uuptime(), up);
+    exit(1);
+  }
+  if(nsnow() / (1000000000 / 10) < up){
+    printf("usysbench: clock_gettime behind uptime\n");
+    exit(1);
+  }
+  ppid = getpid();
+  if((pid = fork()) == 0){
+    if(ugetppid() != ppid || ugetpid() != getpid()){
+      printf("usysbench: ugetppid %d, parent %d\n", ugetppid(), ppid);
+      exit(1);
+    }
+    exit(0);
+  }
+  wait(&i);
+  if(pid < 0 || i != 0)
+    exit(1);
+  printf("%d calls each; on cpu %d, stack limit %ld bytes\n",
+         n, ugetcpu(), getrlimit(RLIMIT_STACK));
+
+  t = nsnow();
+  for(i = 0; i < n; i++)
+    uptime();
+  report("uptime()", nsnow() - t, n);
+  t = nsnow();
+  for(i = 0; i < n; i++)
+    uuptime();
+  report("uuptime()", nsnow() - t, n);
+  t = nsnow();
+  for(i = 0; i < n; i++)
+    getpid();
+  report("getpid()", nsnow() - t, n);
+  t = nsnow();
+  for(i = 0; i < n; i++)
+    ugetpid();
+  report("ugetpid()", nsnow() - t, n);
+  t = nsnow();
+  for(i = 0; i < n; i++)
+    ugetppid();
+  report("ugetppid()", nsnow() - t, n);
+  exit(0);
+}
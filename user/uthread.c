@@ -0,0 +1,97 @@
+// Threads that share the address space and open files
+// of the process that makes them, on top of clone() and join().
+//
+// A thread runs fn(arg) on a stack of its own and exits with
+// fn's return value. Only the thread that created a thread
+// can join it. If the process's first thread exits, the
+// others exit too.
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define TSTACK (4*4096)   // bytes of stack per thread
+
+struct uthread {
+  int tid;
+  int (*fn)(void*);
+  void *arg;
+  char *stack;
+  struct uthread *next;
+};
+
+// threads not yet joined.
+static struct uthread *threads;
+static volatile int lock;
+
+static void
+acquire(void)
+{
+  while(__sync_lock_test_and_set(&lock, 1) != 0)
+    ;
+}
+
+static void
+release(void)
+{
+  __sync_lock_release(&lock);
+}
+
+static void
+start(void *arg)
+{
+  struct uthread *t = arg;
+
+  exit(t->fn(t->arg));
+}
+
+// Start a thread running fn(arg), returning its thread id,
+// or -1 if there are too many threads or not enough memory.
+int
+thread_create(int (*fn)(void*), void *arg)
+{
+  struct uthread *t;
+
+  if((t = malloc(sizeof(*t))) == 0)
+    return -1;
+  if((t->stack = malloc(TSTACK)) == 0){
+    free(t);
+    return -1;
+  }
+  t->fn = fn;
+  t->arg = arg;
+  if((t->tid = clone(start, t, t->stack + TSTACK)) < 0){
+    free(t->stack);
+    free(t);
+    return -1;
+  }
+  acquire();
+  t->next = threads;
+  threads = t;
+  release();
+  return t->tid;
+}
+
+// Wait for thread tid to exit, and free its stack. If status
+// is not null, store fn's return value there.
+// Returns tid, or -1 if the caller did not create tid.
+int
+thread_join(int tid, int *status)
+{
+  struct uthread *t, **tp;
+
+  if(tid <= 0 || join(tid, status) != tid)
+    return -1;
+  acquire();
+  for(tp = &threads; (t = *tp) != 0; tp = &t->next){
+    if(t->tid == tid){
+      *tp = t->next;
+      break;
+    }
+  }
+  release();
+  if(t){
+    free(t->stack);
+    free(t);
+  }
+  return tid;
+}